@@ -0,0 +1,90 @@
+#ifndef __ANALOG_H__
+#define __ANALOG_H__
+
+#include <stdint.h>
+#include "hall.h"
+
+/* Потенциометры и фейдеры: TRGO TIM5 запускает инжектированную группу
+   ADC1, результаты забираются из JDR1..JDR4 в прерывании JEOC. DMA здесь
+   нет намеренно: ADC1 обслуживает только DMA2, а он уже носит GPIO
+   клавиш и энкодеров по AHB. Одновременные передачи DMA2 с AHB и APB2 -
+   случай порчи данных из errata STM32F401, отдельного пути у АЦП нет */
+#define ANALOG_INPUTS           4U     // ранги инжектированной группы, см. MX_ADC1_Init
+#if ANALOG_INPUTS < 1U || ANALOG_INPUTS > 4U
+#error "The injected group holds 1..4 ranks"
+#endif
+
+/* Режим барабанных пэдов (pads.h): пьезодатчикам нужен опрос от 5 кГц,
+   16-канальным мультиплексорам при этом не хватает времени АЦП */
+#ifndef ANALOG_PADS
+#define ANALOG_PADS             0
+#endif
+
+/* Внешние мультиплексоры на каждом входе АЦП, адрес общий на линиях S0..S3
+   (PC13, PC14, PC15, PB1). Адрес следующей последовательности ставится
+   первым делом в прерывании JEOC, до запуска успевает установиться.
+   Установка - RC источника и емкости общего вывода: 10 кОм потенциометра
+   (худший случай) на ~50 пФ 74HC4067 и АЦП дают tau 0,5 мкс, до 1/2 МЗР
+   12 бит - 9 tau, ~4,5 мкс. Запас 20 мкс - проверенное значение; 10 мкс
+   только для клавиш Холла (выход датчика низкоомный) и 5 мкс для пэдов
+   (CD4051, 8 адресов) - сократив, проверить на плате: при нехватке
+   соседние выводы просачиваются друг в друга */
+#if ANALOG_PADS
+#define ANALOG_MUX_WAYS         8U     // 1 - без мультиплексоров, 8 - CD4051, 16 - 74HC4067
+#define ANALOG_MUX_SETTLE_US    5U     // сколько ждать после смены адреса
+#define ANALOG_REFRESH_HZ       5000U  // опросов каждого потенциометра в секунду
+#elif HALL_KEYS
+#define ANALOG_MUX_WAYS         16U
+#define ANALOG_MUX_SETTLE_US    10U
+#define ANALOG_REFRESH_HZ       2000U  // клавишам Холла нужно не меньше 2 кГц
+#else
+#define ANALOG_MUX_WAYS         16U
+#define ANALOG_MUX_SETTLE_US    20U
+#define ANALOG_REFRESH_HZ       1000U
+#endif
+#define ANALOG_POTS             (ANALOG_INPUTS * ANALOG_MUX_WAYS)
+#define ANALOG_SCAN_HZ          (ANALOG_REFRESH_HZ * ANALOG_MUX_WAYS)  // последовательностей в секунду
+
+/* Индекс потенциометра (мультиплексор * ANALOG_MUX_WAYS + вывод) в плоских
+   массивах, где последовательность одного адреса лежит подряд */
+#define ANALOG_INDEX(pot)       ((pot) % ANALOG_MUX_WAYS * ANALOG_INPUTS + (pot) / ANALOG_MUX_WAYS)
+
+/* Период последовательности: преобразование, вход в прерывание JEOC до
+   смены адреса, установка мультиплексоров. ADC_IRQn на приоритете 0, USB
+   и опрос клавиш ниже, так что до смены адреса - только вход в
+   прерывание и десяток команд (<0,5 мкс при 84 МГц); бюджет взят с
+   запасом. Фактический максимум - Analog_GetSelectMax, нарушения
+   бюджета считает Analog_GetLate */
+#define ANALOG_CONV_US          (ANALOG_INPUTS * 96U / 21U + 1U)               // 84 + 12 тактов ADCCLK 21 МГц на ранг
+#define ANALOG_SELECT_US        1U
+#if 1000000U / ANALOG_SCAN_HZ < ANALOG_CONV_US + ANALOG_SELECT_US + ANALOG_MUX_SETTLE_US
+#error "ANALOG_REFRESH_HZ * ANALOG_MUX_WAYS leaves no time for mux settling"
+#endif
+
+/* Фильтр, клавиши Холла, пэды и сенсоры касания разбирают круг в PendSV
+   ниже USB и TIM10. Не успел до конца следующего круга - круг пропадает,
+   счет в Analog_GetOverruns */
+#define ANALOG_CYCLE_PRIORITY   2U
+
+/* Фильтр: однополюсный ФНЧ y += a(x - y) сразу по всем потенциометрам в
+   q15 (12 бит АЦП << 3), затем гистерезис и квантование до ANALOG_BITS */
+#define ANALOG_FILTER_ALPHA     0x4000 // a = 0,5 в q15, постоянная времени ~1,4 опроса
+#define ANALOG_HYSTERESIS       24     // в единицах q15, 3 отсчета АЦП за границей шага
+#ifndef ANALOG_BITS
+#define ANALOG_BITS             7U     // разрядность значения контроллера, 7 или 14
+#endif
+#if ANALOG_BITS > 7
+#define ANALOG_CC_FIRST         16U    // 14 бит: пары CC 16..31 и 48..63, по 16 на канал MIDI
+#else
+#define ANALOG_CC_FIRST         102U   // CC потенциометра 0, дальше подряд по 16 на канал MIDI
+#endif
+
+void Analog_init(void);
+void Analog_Sequence(void);                                                     // начало ADC_IRQHandler
+void Analog_Cycle(void);                                                        // PendSV_Handler
+uint16_t Analog_Get(uint8_t pot);                                               // pot = мультиплексор * ANALOG_MUX_WAYS + вывод, значение в ANALOG_BITS
+uint32_t Analog_GetSelectMax(void);                                             // худший запуск -> смена адреса, тиков 84 МГц
+uint32_t Analog_GetLate(void);                                                  // последовательностей с установкой короче ANALOG_MUX_SETTLE_US
+uint32_t Analog_GetOverruns(void);                                              // пропавших кругов
+
+#endif
@@ -1,5 +1,31 @@
-#ifndef __ENCODER
-void Encoder_init(void);
+#ifndef __ENCODER_H__
+#define __ENCODER_H__
+
+#include <stdint.h>
+#include "stm32f4xx_hal.h"
+
+/* Аппаратный энкодер TIM2 в режиме x4: счетчик меняется на каждом фронте
+   A и B. Остальные декодируются программно: TIM1 CC2 (частота строк
+   матрицы, 80 кГц) через DMA2 Stream2 снимает IDR порта в кольцо, тик
+   TIM10 разбирает накопленные отсчеты таблицей переходов. Знаковые
+   приращения складываются и уходят одним относительным CC за кадр USB */
+#define ENCODER_HW_COUNT        1U
+#define ENCODER_SW_COUNT        2U     // до 8 на порт: A на четном выводе, B на следующем
+#define ENCODER_COUNT           (ENCODER_HW_COUNT + ENCODER_SW_COUNT)
+#define ENCODER_SW_PORT         GPIOB
+#define ENCODER_SW_PINS         (GPIO_PIN_4 | GPIO_PIN_5 | GPIO_PIN_6 | GPIO_PIN_7)
+#define ENCODER_SW_SAMPLES      256U   // отсчетов в кольце, больше чем за тик
+#define ENCODER_DIVIDER         1U     // отсчетов x4 на шаг дельты, 4 - шаг на щелчок
 
+/* Ускорение: по времени между отсчетами (мс на отсчет по тику) берется
+   множитель из кривой. Медленно - 1, быстрый рывок - до ENCODER_ACCEL_MAX */
+#define ENCODER_ACCEL_STEPS     32U    // точек кривой, 0..31 мс на отсчет
+#define ENCODER_ACCEL_MAX       16U
+#define ENCODER_ACCEL_KNEE      16U    // с этого периода и медленнее множитель 1
+
+void Encoder_init(void);
+void Encoder_Tick(void);
+int32_t Encoder_GetPosition(uint8_t enc);
+void Encoder_SetAccelCurve(const uint8_t* curve);
 
-#endif 
+#endif
@@ -29,6 +29,8 @@ extern "C" {
 #include "main.h"
 
 /* USER CODE BEGIN Includes */
+#include "keys.h"
+#include "encoder.h"
 
 /* USER CODE END Includes */
 
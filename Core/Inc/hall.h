@@ -0,0 +1,41 @@
+#ifndef __HALL_H__
+#define __HALL_H__
+
+#include <stdint.h>
+#include "arm_math.h"
+
+/* Клавиши на датчиках Холла: первые HALL_KEYS потенциометров аналогового
+   тракта (мультиплексор 0, у 8-канальных 0 и 1) - ход клавиш, а не CC.
+   Ход разбирается на каждом круге мультиплексоров, ANALOG_REFRESH_HZ раз
+   в секунду. По умолчанию выключены: включение поднимает опрос до 2 кГц */
+#ifndef HALL_KEYS
+#define HALL_KEYS               0U     // 16 - весь мультиплексор 0
+#endif
+#define HALL_NOTE_FIRST         48U    // C3
+#define HALL_CHANNEL            0U
+
+/* Ход клавиши 0..HALL_TRAVEL_MAX. Покой и низ калибруются по крайним
+   значениям сглаженного отсчета, одиночный выброс сдвигает их на 1/2^HALL_CAL_SHIFT */
+#define HALL_TRAVEL_MAX         1023U
+#define HALL_CAL_SHIFT          3U     // ФНЧ калибровки, постоянная ~8 кругов (4 мс)
+#define HALL_RANGE_MIN          8192   // начальный размах покой-низ в q15, пока клавиша не нажата до конца
+#define HALL_ACTUATE            400U   // ход нажатия по умолчанию
+#define HALL_RELEASE            300U   // ход отпускания по умолчанию
+#define HALL_RT_SENSITIVITY     40U    // rapid trigger: разворот хода на столько - новое событие
+#define HALL_RT_DEADZONE        100U   // rapid trigger: выше этого хода клавиша всегда отпущена
+#define HALL_SLOPE_MAX          300U   // ход за 2 круга, дающий скорость 127
+
+/* Poly Key Pressure по ходу ниже точки срабатывания, только для нажатых
+   клавиш: проход по битовой карте нажатых, а не по всем клавишам */
+#define HALL_AFTERTOUCH         1
+#define HALL_AT_INTERVAL        (ANALOG_REFRESH_HZ / 200U)  // кругов между сообщениями одной клавиши, 5 мс
+#define HALL_AT_DEADBAND        2U     // изменение 7-битного давления, меньше - не отправлять
+
+void Hall_init(const q15_t* raw);
+void Hall_Process(const q15_t* raw);
+void Hall_SetThresholds(uint8_t key, uint16_t actuate, uint16_t release);
+void Hall_SetRapidTrigger(uint8_t key, uint8_t on, uint16_t sensitivity);
+uint16_t Hall_GetTravel(uint8_t key);
+uint32_t Hall_GetHeld(void);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __KEYS_H__
+#define __KEYS_H__
+
+#include <stdint.h>
+#include "stm32f4xx_hal.h"
+
+#define KEYS_TICK_HZ            1000U  // частота опроса клавиш таймером TIM10
+#define KEYS_DEBOUNCE_BITS      4U     // разрядность вертикальных счетчиков, до 15 тиков
+#define KEYS_DEBOUNCE_MS        5U     // время дребезга по умолчанию
+
+/* Матрица клавиш: TIM1 по переполнению опускает очередную строку через
+   DMA2 в BSRR, по CC1 DMA2 же снимает IDR столбцов. Процессор в
+   сканировании не участвует. DMA2 работает только с GPIO на AHB: по
+   errata STM32F401 одновременные передачи DMA2 с AHB и APB2 портят
+   данные, поэтому АЦП (APB2) на DMA2 не вешается, см. analog.h */
+#define KEYS_SCAN_HZ            10000U // полных сканов матрицы в секунду
+#define KEYS_SCAN_DEPTH         16U    // сканов в кольцевом буфере, больше чем за тик опроса
+#define KEYS_ROWS               8U
+#define KEYS_COLS               8U
+
+/* Клавиатура с двумя контактами на клавишу: четная строка - первый
+   контакт (начало хода), следующая за ней - второй (низ хода). Скорость -
+   время между ними, с точностью до периода скана. Пара строк уходит на
+   одну клавишу, и матрица 8x8 дает только 32 клавиши: это клавиатуры на
+   25-32 клавиши. Для 61 клавиши со скоростью нужно 16 строк и 8 столбцов,
+   для 88 - 16 строк и 11 столбцов (выводы в keys_row_pin/keys_col_pin,
+   keys.c, столбцов не больше 16) */
+#ifndef KEYS_DUAL_CONTACT
+#define KEYS_DUAL_CONTACT       0
+#endif
+#if KEYS_DUAL_CONTACT
+#define KEYS_CONTACTS           2U
+#if KEYS_ROWS % 2U
+#error "KEYS_DUAL_CONTACT: нужно четное число строк"
+#endif
+#else
+#define KEYS_CONTACTS           1U
+#endif
+#define KEYS_COUNT              (KEYS_ROWS / KEYS_CONTACTS * KEYS_COLS)
+
+#define KEYS_CONTACT_SCANS      3U     // антидребезг первого контакта в сканах, 300 мкс
+#define KEYS_BOUNCE_SCANS       10U    // замыкания в пределах 1 мс - один дребезг, время от первого
+#define KEYS_VELOCITY_STEPS     64U    // точек кривой скорости, время по логарифмической шкале
+#define KEYS_VELOCITY_FAST_US   1500U  // быстрее - скорость 127
+#define KEYS_VELOCITY_SLOW_US   80000U // медленнее - скорость 1
+#define KEYS_NOTE_FIRST         36U    // C2, нижняя клавиша 61-клавишной клавиатуры
+
+/* Строки - выходы с открытым стоком, столбцы - входы с подтяжкой, на
+   каждой клавише диод от столбца к строке */
+#define KEYS_ROW_PORT           GPIOA
+#define KEYS_ROW_PINS           (GPIO_PIN_0 | GPIO_PIN_2 | GPIO_PIN_3 | GPIO_PIN_4 | \
+                                 GPIO_PIN_5 | GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_10)
+#define KEYS_COL_PORT           GPIOB
+#define KEYS_COL_PINS           (GPIO_PIN_2 | GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_10 | \
+                                 GPIO_PIN_12 | GPIO_PIN_13 | GPIO_PIN_14 | GPIO_PIN_15)
+
+/* Антидребезг 16 линий порта вертикальными счетчиками: бит b счетчика
+   всех линий лежит в одном слове cnt[b], поэтому весь порт считается
+   за несколько логических операций */
+typedef struct Debounce{
+	uint16_t state;                         // отфильтрованное состояние, 1 = нажата
+	uint16_t cnt[KEYS_DEBOUNCE_BITS];       // сколько тиков еще ждать смены состояния
+	uint16_t reload[KEYS_DEBOUNCE_BITS];    // время дребезга каждой линии в тиках
+}Debounce;
+
+void Debounce_init(Debounce* d, uint8_t ticks);
+void Debounce_SetTime(Debounce* d, uint16_t mask, uint8_t ticks);
+uint16_t Debounce_Update(Debounce* d, uint16_t raw);
+
+void Keys_init(void);
+void Keys_SetDebounce(uint8_t key, uint8_t ms);
+void Keys_Tick(void);
+uint16_t Keys_GetState(uint8_t row);
+uint8_t Keys_VelocityIndex(uint32_t us);
+void Keys_SetVelocityCurve(const uint8_t* curve);
+
+#endif
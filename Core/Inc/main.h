@@ -69,8 +69,7 @@ typedef struct NoteOnOff{
 	}NoteOnOff;
 
 
-	void send_note_message(uint8_t note);
-	void delay_ms(uint16_t ms);
+	void send_note_message(uint8_t note, ButState state, uint8_t velocity);
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
@@ -0,0 +1,25 @@
+#ifndef __MIDI_COALESCE_H__
+#define __MIDI_COALESCE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "midi_queue.h"
+
+/* Сколько разных контроллеров одного кабеля копится за кадр */
+#define MIDI_COALESCE_SLOTS 16U
+
+/* Вид копимого сообщения */
+#define MIDI_COALESCE_CONTROL  0x0B   // абсолютный CC, побеждает последнее значение
+#define MIDI_COALESCE_CONTROL14 0x1B  // 14-битный CC (пара MSB/LSB в MIDI 1.0), побеждает последнее значение
+#define MIDI_COALESCE_RELATIVE 0x05   // относительный контроллер, дельты складываются
+#define MIDI_COALESCE_POLY_PRESSURE 0x0A  // Poly Key Pressure, индекс - нота, побеждает последнее значение
+
+bool MIDI_Coalesce_Control(MIDI_QueueId q, uint8_t channel, uint8_t index, uint32_t value);
+bool MIDI_Coalesce_Control14(MIDI_QueueId q, uint8_t channel, uint8_t index, uint32_t value);
+bool MIDI_Coalesce_Relative(MIDI_QueueId q, uint8_t channel, uint8_t index, int32_t delta);
+bool MIDI_Coalesce_PolyPressure(MIDI_QueueId q, uint8_t channel, uint8_t note, uint32_t value);
+void MIDI_Coalesce_Poll(MIDI_QueueId q);
+void MIDI_Coalesce_Flush(MIDI_QueueId q);
+uint32_t MIDI_Coalesce_Saved(MIDI_QueueId q);
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef __MIDI_MESSAGE_H__
+#define __MIDI_MESSAGE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "midi_queue.h"
+
+/* Code Index Number, младший полубайт байта 0 USB-MIDI пакета */
+#define MIDI_CIN_MISC             0x0
+#define MIDI_CIN_CABLE_EVENT      0x1
+#define MIDI_CIN_SYSCOMMON_2      0x2
+#define MIDI_CIN_SYSCOMMON_3      0x3
+#define MIDI_CIN_SYSEX_START      0x4
+#define MIDI_CIN_SYSEX_END_1      0x5   // или однобайтовое System Common
+#define MIDI_CIN_SYSEX_END_2      0x6
+#define MIDI_CIN_SYSEX_END_3      0x7
+#define MIDI_CIN_NOTE_OFF         0x8
+#define MIDI_CIN_NOTE_ON          0x9
+#define MIDI_CIN_POLY_PRESSURE    0xA
+#define MIDI_CIN_CONTROL_CHANGE   0xB
+#define MIDI_CIN_PROGRAM_CHANGE   0xC
+#define MIDI_CIN_CHANNEL_PRESSURE 0xD
+#define MIDI_CIN_PITCH_BEND       0xE
+#define MIDI_CIN_SINGLE_BYTE      0xF
+
+/* Message Type UMP, старший полубайт первого слова */
+#define MIDI_MT_UTILITY           0x0   // NOOP, JR Clock, JR Timestamp
+#define MIDI_MT_SYSTEM            0x1
+#define MIDI_MT_MIDI1_VOICE       0x2
+#define MIDI_MT_SYSEX7            0x3
+#define MIDI_MT_MIDI2_VOICE       0x4
+
+/* Статусы MIDI 2.0 Channel Voice, которых нет в MIDI 1.0 */
+#define MIDI2_REG_PER_NOTE_CTRL   0x0
+#define MIDI2_ASSIGN_PER_NOTE_CTRL 0x1
+#define MIDI2_REG_CTRL            0x2   // RPN одним сообщением
+#define MIDI2_ASSIGN_CTRL         0x3   // NRPN одним сообщением
+#define MIDI2_REL_ASSIGN_CTRL     0x5
+
+/* Первое слово UMP: MT, группа (номер кабеля), статус и два байта */
+#define MIDI_UMP(mt, group, status, b2, b3) (((uint32_t)(mt) << 28) | ((uint32_t)((group) & 0x0F) << 24) | \
+                                             ((uint32_t)(status) << 16) | ((uint32_t)(b2) << 8) | (uint32_t)(b3))
+
+/* Метка группы в очереди: следующие n слов уходят одной передачей USB.
+   Для MIDI 1.0 это пакет кабеля 0 с зарезервированным CIN 0, для UMP -
+   служебное сообщение с несуществующим статусом F. Наружу не передается */
+#define MIDI_GROUP(n)             (0x00F00000UL | ((uint32_t)(n) << 8))
+#define MIDI_IS_GROUP(word)       (((word) & 0xFFFF00FFUL) == 0x00F00000UL)
+
+/* JR Timestamp в UMP: ставить перед нотами, тик 1/31250 с. Время
+   считается от кадров USB, JR Clock раз в MIDI_JR_CLOCK_FRAMES кадров
+   привязывает к нему часы хоста */
+#ifndef MIDI_UMP_JR_TIMESTAMPS
+#define MIDI_UMP_JR_TIMESTAMPS    1
+#endif
+#define MIDI_JR_CLOCK_FRAMES      250U  // 250 мс
+
+/* Наибольшая дельта одного относительного CC в MIDI 1.0. Больше - несколько
+   CC подряд, до MIDI_RELATIVE_SPLIT в одной группе */
+#define MIDI_RELATIVE_DELTA_MAX   63
+#define MIDI_RELATIVE_SPLIT       8U
+
+typedef enum{
+	MIDI_PROTOCOL_1_0 = 0,    // альтернативная настройка 0, 32-битные пакеты USB-MIDI 1.0
+	MIDI_PROTOCOL_2_0         // альтернативная настройка 1, Universal MIDI Packet
+}MIDI_Protocol;
+
+/* Кодирование дельты относительного CC в MIDI 1.0 (значение 0..127) */
+typedef enum{
+	MIDI_RELATIVE_TWOS_COMPLEMENT = 0,  // +1..+63 = 1..63, -1..-63 = 127..65
+	MIDI_RELATIVE_BINARY_OFFSET,        // 64 + дельта
+	MIDI_RELATIVE_SIGN_MAGNITUDE        // бит 6 - знак минус, биты 0..5 - модуль
+}MIDI_RelativeEncoding;
+
+typedef enum{
+	MIDI_PARAM_RPN = 0,       // CC 101/100
+	MIDI_PARAM_NRPN           // CC 99/98
+}MIDI_ParamType;
+
+typedef enum{
+	MIDI_MSG_NOTE_OFF = 0,
+	MIDI_MSG_NOTE_ON,
+	MIDI_MSG_POLY_PRESSURE,
+	MIDI_MSG_CONTROL_CHANGE,
+	MIDI_MSG_PROGRAM_CHANGE,
+	MIDI_MSG_CHANNEL_PRESSURE,
+	MIDI_MSG_PITCH_BEND,
+	MIDI_MSG_SYSTEM_COMMON,   // F1..F6, status + до двух байт данных
+	MIDI_MSG_REALTIME         // F8..FF, только статус
+}MIDI_MessageType;
+
+typedef struct MIDI_Message{
+	uint8_t Type;             // MIDI_MessageType
+	uint8_t Cable;
+	uint8_t Channel;          // 0..15 для канальных сообщений
+	uint8_t Status;
+	uint8_t Data1;
+	uint8_t Data2;
+	uint32_t Value;           // MIDI 1.0: Data2 или 14 бит Pitch Bend, UMP MIDI 2.0: полное разрешение (16 бит скорость, 32 бита контроллер)
+}MIDI_Message;
+
+/* Флаги куска принятого SysEx */
+#define MIDI_SYSEX_START 0x01    // кусок начинается сразу после F0
+#define MIDI_SYSEX_END   0x02    // после куска пришел F7
+
+/* Источник данных SysEx: копирует до max байт начиная с offset, возвращает
+   сколько скопировал. Меньше max - данных пока нет: пакет не отправляется,
+   и тот же offset запрашивается снова на следующем SOF */
+typedef uint32_t (*MIDI_SysExReader)(uint32_t offset, uint8_t* dst, uint32_t max);
+
+void MIDI_SetProtocol(MIDI_Protocol protocol);
+MIDI_Protocol MIDI_GetProtocol(void);
+uint8_t MIDI_GetEpoch(void);                                                    // номер потока, им помечены сообщения в очередях
+void MIDI_SetRelativeEncoding(MIDI_RelativeEncoding encoding);
+MIDI_RelativeEncoding MIDI_GetRelativeEncoding(void);
+uint32_t MIDI_Upscale(uint32_t value, uint8_t src_bits, uint8_t dst_bits);
+uint32_t MIDI_WordCount(uint32_t first);
+
+/* Номер кабеля (группы UMP) сообщения - номер очереди q */
+bool MIDI_SendNoteOn(MIDI_QueueId q, uint8_t channel, uint8_t note, uint16_t velocity);
+bool MIDI_SendNoteOff(MIDI_QueueId q, uint8_t channel, uint8_t note, uint16_t velocity);
+bool MIDI_SendControl(MIDI_QueueId q, uint8_t channel, uint8_t index, uint32_t value);
+bool MIDI_SendControl14(MIDI_QueueId q, uint8_t channel, uint8_t index, uint32_t value);
+bool MIDI_SendParameter(MIDI_QueueId q, uint8_t channel, MIDI_ParamType type, uint16_t param, uint32_t value);
+int32_t MIDI_SendRelative(MIDI_QueueId q, uint8_t channel, uint8_t index, int32_t delta);  // остаток, не влезший в очередь
+bool MIDI_SendPolyPressure(MIDI_QueueId q, uint8_t channel, uint8_t note, uint32_t value);
+bool MIDI_SendPerNoteControl(MIDI_QueueId q, uint8_t channel, uint8_t note, uint8_t index, uint32_t value);
+bool MIDI_SendRealtime(MIDI_QueueId q, uint8_t status);
+bool MIDI_SendJRClock(MIDI_QueueId q);
+
+void MIDI_ParsePackets(const uint8_t* buf, uint32_t len);
+void MIDI_ParseUMP(const uint32_t* words, uint32_t count);
+void MIDI_RxCallback(const MIDI_Message* msg);
+void MIDI_SysExRxCallback(uint8_t cable, const uint8_t* data, uint32_t len, uint8_t flags);
+
+bool MIDI_SysEx_Send(uint8_t cable, const uint8_t* data, uint32_t len);
+bool MIDI_SysEx_SendStream(uint8_t cable, uint32_t len, MIDI_SysExReader reader);
+bool MIDI_SysEx_TxBusy(void);
+bool MIDI_SysEx_TxOwns(uint8_t cable);
+void MIDI_SysEx_Abort(void);
+uint32_t MIDI_SysEx_Encode(uint32_t* packets, uint32_t max);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __MIDI_QUEUE_H__
+#define __MIDI_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Глубина очереди в 32-битных словах (пакет USB-MIDI 1.0 или слово UMP),
+   обязательно степень двойки */
+#define MIDI_QUEUE_SIZE 64U
+#define MIDI_QUEUE_MASK (MIDI_QUEUE_SIZE - 1U)
+
+#if (MIDI_QUEUE_SIZE & MIDI_QUEUE_MASK) != 0U
+#error "MIDI_QUEUE_SIZE must be a power of two"
+#endif
+
+/* USB-MIDI пакет в том виде, как он лежит в памяти (байт 0 = кабель/CIN) */
+#define MIDI_PACKET(b0, b1, b2, b3) ((uint32_t)(b0) | ((uint32_t)(b1) << 8) | \
+                                     ((uint32_t)(b2) << 16) | ((uint32_t)(b3) << 24))
+
+/* Своя очередь на каждый виртуальный кабель, номер очереди = номер кабеля
+   (группы UMP). У каждой очереди один источник */
+typedef enum{
+	MIDI_QUEUE_KEYS = 0,     // кабель 0, клавиши - прерывание опроса TIM10
+	MIDI_QUEUE_ENCODERS,     // кабель 1, энкодеры - прерывание опроса TIM10
+	MIDI_QUEUE_ANALOG,       // кабель 2, АЦП - PendSV круга опроса
+	MIDI_QUEUE_REALTIME,     // кабель 3, Active Sensing и клок - главный цикл
+	MIDI_QUEUE_COUNT
+}MIDI_QueueId;
+
+/* Кольцо один писатель / один читатель: head пишет только источник,
+   tail - только потребитель (SOF прерывание USB). У каждого слова метка
+   потока (MIDI_GetEpoch), в формате которого оно собрано */
+typedef struct MIDI_Queue{
+	uint32_t buf[MIDI_QUEUE_SIZE];
+	uint8_t tag[MIDI_QUEUE_SIZE];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t drops;       // потеряно пакетов из-за переполнения
+	volatile uint32_t high_water;  // максимальное заполнение
+}MIDI_Queue;
+
+extern MIDI_Queue midi_queue[MIDI_QUEUE_COUNT];
+
+bool MIDI_Queue_Push(MIDI_QueueId id, uint32_t packet, uint8_t tag);
+bool MIDI_Queue_PushN(MIDI_QueueId id, const uint32_t* words, uint32_t n, uint8_t tag);
+bool MIDI_Queue_Pop(MIDI_QueueId id, uint32_t* packet);
+bool MIDI_Queue_Peek(MIDI_QueueId id, uint32_t* packet, uint8_t* tag);
+void MIDI_Queue_Flush(MIDI_QueueId id);
+uint32_t MIDI_Queue_Count(MIDI_QueueId id);
+uint32_t MIDI_Queue_Drops(MIDI_QueueId id);
+uint32_t MIDI_Queue_HighWater(MIDI_QueueId id);
+void MIDI_Queue_ResetStats(MIDI_QueueId id);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __PADS_H__
+#define __PADS_H__
+
+#include <stdint.h>
+#include "arm_math.h"
+#include "analog.h"
+
+/* Барабанные пэды на пьезодатчиках: PADS_COUNT потенциометров аналогового
+   тракта с PADS_FIRST (в режиме ANALOG_PADS - мультиплексоры 2 и 3).
+   Удар - всплеск в доли миллисекунды, скорость - пик за окно PADS_SCAN_US
+   от первого отсчета выше порога */
+#if ANALOG_PADS
+#define PADS_COUNT              16U    // 8..16
+#else
+#define PADS_COUNT              0U
+#endif
+#define PADS_FIRST              16U    // сразу после клавиш Холла
+#define PADS_NOTE_FIRST         36U    // C1, Bass Drum по GM
+#define PADS_CHANNEL            9U     // канал 10, ударные
+
+/* Порог и пик в q15 над отсчетом покоя */
+#define PADS_THRESHOLD          1024   // 128 отсчетов АЦП, ~100 мВ
+#define PADS_PEAK_MAX           28672  // пик, дающий скорость 127
+
+/* Удар до Note On: до круга на обнаружение, окно, до кадра USB - меньше 2 мс */
+#define PADS_SCAN_US            600U   // окно поиска пика
+#define PADS_MASK_MS            30U    // маска повтора: звон пьезо не дает второй удар, в конце Note Off
+#define PADS_SCAN_CYCLES        (PADS_SCAN_US * ANALOG_REFRESH_HZ / 1000000U)
+#define PADS_MASK_CYCLES        (PADS_MASK_MS * ANALOG_REFRESH_HZ / 1000U)
+
+/* Перекрестные наводки: удар на соседе слабее PADS_XTALK_PERCENT пика
+   громкого пэда отбрасывается. Пик соседа затухает за ~2^PADS_XTALK_SHIFT кругов */
+#define PADS_XTALK_PERCENT      50U
+#define PADS_XTALK_SHIFT        4U     // 3 мс при 5 кГц
+
+void Pads_init(const q15_t* raw);
+void Pads_Process(const q15_t* raw);
+void Pads_SetNeighbours(uint8_t pad, uint32_t mask);                            // маска пэдов, наводящих на pad, по умолчанию pad - 1 и pad + 1
+
+#endif
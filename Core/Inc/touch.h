@@ -0,0 +1,37 @@
+#ifndef __TOUCH_H__
+#define __TOUCH_H__
+
+#include <stdint.h>
+#include "analog.h"
+
+/* Емкостные сенсоры касания (ручки энкодеров, фейдеры, пэды): электроды на
+   выводах мультиплексора 1, общий вывод PA6 - это и IN6, и TIM3 CH1. Пока
+   мультиплексоры стоят на адресе электрода, PA6 разряжает его выходом на
+   время разбора последовательности, затем отпускает на внутреннюю подтяжку,
+   и захват TIM3 CH1 ловит фронт: время заряда растет с емкостью пальца.
+   Заряд идет между последовательностями АЦП, отсчет IN6 этого адреса
+   отбрасывается, ожидания нет. Каждый электрод - раз за круг */
+#ifndef TOUCH_COUNT
+#define TOUCH_COUNT             0U     // 4 - электроды на выводах 12..15, не в режиме пэдов
+#endif
+#define TOUCH_WAY_FIRST         12U    // выводы 12..15 мультиплексора 1
+#define TOUCH_POT_FIRST         (ANALOG_MUX_WAYS + TOUCH_WAY_FIRST)
+#define TOUCH_NOTE_FIRST        104U   // Mackie Control: касание фейдера 1..8 - ноты 0x68..0x6F
+#define TOUCH_CHANNEL           0U
+
+/* Время заряда в тиках TIM3 (84 МГц) над базой. База идет за медленным
+   дрейфом (температура, влажность) только без касания: вниз сразу, вверх
+   на 1/16 тика за TOUCH_DRIFT_CYCLES кругов */
+#define TOUCH_ON                24U    // ~0,3 мкс, палец добавляет несколько пФ
+#define TOUCH_OFF               16U
+#define TOUCH_DRIFT_CYCLES      16U    // ~4 тика в секунду при 1 кГц
+#define TOUCH_TIMEOUT           0xFFFFU // фронта нет - вывод закорочен или электрод не подключен, отсчета нет
+
+void Touch_init(void);
+void Touch_Discharge(uint8_t addr, uint8_t next);
+void Touch_Charge(void);
+void Touch_Process(void);
+uint8_t Touch_Get(uint8_t sensor);
+uint16_t Touch_GetTicks(uint8_t sensor);
+
+#endif
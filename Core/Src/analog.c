@@ -0,0 +1,165 @@
+#include "analog.h"
+#include "adc.h"
+#include "midi_message.h"
+#include "midi_coalesce.h"
+#include "arm_math.h"
+#include "hall.h"
+#include "pads.h"
+#include "touch.h"
+
+static void Analog_Select(uint8_t addr);
+static void Analog_Filter(const q15_t* raw);
+
+/* Слова BSRR линий адреса S0..S2 на GPIOC и S3 на GPIOB */
+static uint32_t analog_sel_c[ANALOG_MUX_WAYS];
+static uint32_t analog_sel_b[ANALOG_MUX_WAYS];
+
+/* Плоские массивы по всем потенциометрам: последовательность адреса a
+   лежит подряд с индекса a * ANALOG_INPUTS, как ее пишет АЦП. Сырой круг
+   двойной: прерывание АЦП пишет один, PendSV разбирает другой */
+static q15_t analog_raw[2][ANALOG_POTS];                                         // круги опроса в q15
+static q15_t analog_filt[ANALOG_POTS];                                           // выход фильтра
+static q15_t analog_step[ANALOG_POTS];
+static uint16_t analog_value[ANALOG_POTS];                                       // последнее отправленное значение, ANALOG_BITS
+static uint8_t analog_addr;                                                      // адрес мультиплексоров текущей последовательности
+static uint8_t analog_buf;                                                       // круг, который пишет прерывание АЦП
+static volatile uint8_t analog_busy;                                             // PendSV еще не разобрал прошлый круг
+static uint8_t analog_primed;                                                    // первый круг только запоминается
+
+/* Замеры: от запуска последовательности до смены адреса, в тиках TIM5 */
+static uint32_t analog_settle_ticks;                                             // ANALOG_MUX_SETTLE_US в тиках
+static volatile uint32_t analog_select_max;
+static volatile uint32_t analog_late;
+static volatile uint32_t analog_overruns;
+
+void Analog_init(void){
+	for(uint8_t a = 0; a < ANALOG_MUX_WAYS; a++){
+		analog_sel_c[a] = 0;
+		for(uint8_t b = 0; b < 3U; b++)
+			analog_sel_c[a] |= (a & (1U << b)) ? ((uint32_t)GPIO_PIN_13 << b) : ((uint32_t)GPIO_PIN_13 << b << 16);
+		analog_sel_b[a] = (a & 8U) ? (uint32_t)GPIO_PIN_1 : ((uint32_t)GPIO_PIN_1 << 16);
+	}
+	analog_addr = 0;
+	analog_buf = 0;
+	analog_busy = 0;
+	analog_settle_ticks = SystemCoreClock / 1000000U * ANALOG_MUX_SETTLE_US;
+	Analog_Select(0);
+	Touch_init();
+	HAL_NVIC_SetPriority(PendSV_IRQn, ANALOG_CYCLE_PRIORITY, 0);
+
+	// TIM5 тикает с частотой последовательностей, переполнение через TRGO запускает АЦП
+	RCC->APB1ENR |= RCC_APB1ENR_TIM5EN;
+	TIM5->PSC = 0;                                                               // таймеры APB1 на частоте ядра
+	TIM5->ARR = SystemCoreClock / ANALOG_SCAN_HZ - 1U;
+	TIM5->CR2 = (TIM5->CR2 & ~TIM_CR2_MMS) | TIM_CR2_MMS_1;                      // MMS = 010, update
+	TIM5->EGR = TIM_EGR_UG;
+
+	HAL_ADCEx_InjectedStart_IT(&hadc1);
+	TIM5->CR1 |= TIM_CR1_CEN;
+}
+
+uint16_t Analog_Get(uint8_t pot){
+	if(pot >= ANALOG_POTS) return 0;
+	return analog_value[ANALOG_INDEX(pot)];
+}
+
+static void Analog_Select(uint8_t addr){
+	if(ANALOG_MUX_WAYS < 2U) return;
+	GPIOC->BSRR = analog_sel_c[addr];
+	GPIOB->BSRR = analog_sel_b[addr];
+}
+
+uint32_t Analog_GetSelectMax(void){
+	return analog_select_max;
+}
+
+uint32_t Analog_GetLate(void){
+	return analog_late;
+}
+
+uint32_t Analog_GetOverruns(void){
+	return analog_overruns;
+}
+
+/* Начало ADC_IRQHandler, JEOC: последовательность адреса analog_addr в
+   JDR1..JDR4. Следующая запустится только по TIM5, поэтому адрес
+   переключается первым делом, CNT TIM5 тут же показывает, сколько прошло
+   с запуска. Прерывание на высшем приоритете и без очередей, его время -
+   ANALOG_SELECT_US; если адрес все же сменился позже бюджета, один отсчет
+   снимется на переходе и попадет в analog_late. Все остальное на круг -
+   в PendSV */
+void Analog_Sequence(void){
+	const volatile uint32_t* jdr = &ADC1->JDR1;                                  // JDR1..JDR4 идут подряд
+	q15_t* raw;
+	uint32_t cnt;
+	uint8_t addr = analog_addr;
+	if(!(ADC1->SR & ADC_SR_JEOC)) return;
+	analog_addr = (addr + 1U) % ANALOG_MUX_WAYS;
+	Analog_Select(analog_addr);
+	cnt = TIM5->CNT;
+	ADC1->SR = ~(uint32_t)(ADC_SR_JEOC | ADC_SR_JSTRT);                          // HAL_ADC_IRQHandler ее уже не увидит
+	if(cnt > analog_select_max) analog_select_max = cnt;
+	if(TIM5->ARR + 1U - cnt < analog_settle_ticks) analog_late++;
+	Touch_Discharge(addr, analog_addr);
+	raw = &analog_raw[analog_buf][addr * ANALOG_INPUTS];
+	for(uint8_t i = 0; i < ANALOG_INPUTS; i++) raw[i] = (q15_t)(jdr[i] << 3);
+	if(analog_addr == 0){
+		if(analog_busy){
+			analog_overruns++;                                                       // круг пропадает, пишем его буфер заново
+		}else{
+			analog_busy = 1;
+			analog_buf ^= 1U;
+			SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+		}
+	}
+	Touch_Charge();                                                              // электрод разряжался все время разбора
+}
+
+/* PendSV: полный круг готов в буфере, который прерывание АЦП уже не пишет */
+void Analog_Cycle(void){
+	if(!analog_busy) return;
+	Analog_Filter(analog_raw[analog_buf ^ 1U]);
+	analog_busy = 0;
+}
+
+/* Полный круг мультиплексоров: фильтр, гистерезис, поиск изменений.
+   PendSV - единственный источник очереди аналоговых контроллеров, CC
+   копятся до конца кадра USB */
+static void Analog_Filter(const q15_t* raw){
+	const uint32_t shift = 15U - ANALOG_BITS;
+	MIDI_Coalesce_Poll(MIDI_QUEUE_ANALOG);
+	if(!analog_primed){
+		arm_copy_q15((q15_t*)raw, analog_filt, ANALOG_POTS);
+		for(uint8_t i = 0; i < ANALOG_POTS; i++) analog_value[i] = analog_filt[i] >> shift;
+		Hall_init(raw);
+		Pads_init(raw);
+		analog_primed = 1;
+		return;
+	}
+	Pads_Process(raw);                                                           // пэдам и клавишам фильтр не нужен, только задержка
+	Hall_Process(raw);
+	Touch_Process();
+	arm_sub_q15((q15_t*)raw, analog_filt, analog_step, ANALOG_POTS);
+	arm_scale_q15(analog_step, ANALOG_FILTER_ALPHA, 0, analog_step, ANALOG_POTS);
+	arm_add_q15(analog_filt, analog_step, analog_filt, ANALOG_POTS);
+
+	// значение меняется, только когда фильтр ушел за границы текущего шага
+	// дальше чем на ANALOG_HYSTERESIS: дрожание на границе CC не порождает
+	for(uint8_t i = 0; i < ANALOG_POTS; i++){
+		int32_t y = analog_filt[i];
+		int32_t lo = ((int32_t)analog_value[i] << shift) - ANALOG_HYSTERESIS;
+		int32_t hi = ((int32_t)(analog_value[i] + 1U) << shift) + ANALOG_HYSTERESIS;
+		uint8_t pot = (i % ANALOG_INPUTS) * ANALOG_MUX_WAYS + i / ANALOG_INPUTS;
+#if HALL_KEYS
+		if(pot < HALL_KEYS) continue;
+#endif
+		if((pot >= PADS_FIRST && pot < PADS_FIRST + PADS_COUNT) ||
+		   (pot >= TOUCH_POT_FIRST && pot < TOUCH_POT_FIRST + TOUCH_COUNT) || (y >= lo && y < hi)) continue;
+		analog_value[i] = y >> shift;
+#if ANALOG_BITS > 7
+		MIDI_Coalesce_Control14(MIDI_QUEUE_ANALOG, pot / 16U, ANALOG_CC_FIRST + pot % 16U, MIDI_Upscale(analog_value[i], ANALOG_BITS, 32));
+#else
+		MIDI_Coalesce_Control(MIDI_QUEUE_ANALOG, pot / 16U, ANALOG_CC_FIRST + pot % 16U, MIDI_Upscale(analog_value[i], ANALOG_BITS, 32));
+#endif
+	}
+}
@@ -1,88 +1,143 @@
 #include "encoder.h"
 #include "stm32f4xx_hal.h"
+#include "midi_coalesce.h"
 
-void TIM3_Encoder_init(void){
-	//разрешаем тактирование таймера TIM3
-	RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;
+static TIM_TypeDef* const encoder_tim[ENCODER_HW_COUNT] = {TIM2};
+static const uint8_t encoder_sw_pin[ENCODER_SW_COUNT] = {4, 6};                  // вывод A, B - следующий (бывшие TIM3, TIM4)
+static const uint8_t encoder_cc[ENCODER_COUNT] = {1, 3, 4};                      // номера контроллеров прежние: номер таймера
 
-       //конфигурируем выводы к которым подключается энкодер как входы с подтяжкой к питанию
-	GPIOA->MODER &= ~(GPIO_MODER_MODER6_0 | GPIO_MODER_MODER7_0);
-	GPIOA->MODER |= (GPIO_MODER_MODER6_1 | GPIO_MODER_MODER7_1);
-	GPIOA->PUPDR &= ~(GPIO_PUPDR_PUPDR6 | GPIO_PUPDR_PUPDR7);
-	GPIOA->AFR[0] &= ~(GPIO_AFRL_AFSEL6 | GPIO_AFRL_AFSEL7); 
-	GPIOA->AFR[0] |= (GPIO_AFRL_AFSEL6_1 | GPIO_AFRL_AFSEL7_1);	
-	
-         //настраиваем фильтр
-  TIM3->CCMR1 |= TIM_CCMR1_IC1F | TIM_CCMR1_IC2F;
-        //настраиваем мультиплексор
-	TIM3->CCMR1 |= TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0;
-        //сигнал TIxFP1 появиться по возрастающему фронту
-	TIM3->CCER &= ~(TIM_CCER_CC1P | TIM_CCER_CC2P);
-        //счет по обоим фронтам 
-	//TIM3->SMCR |= TIM_SMCR_SMS_0 | TIM_SMCR_SMS_1;
-			  //счет по одному фронту 
-	TIM3->SMCR |= TIM_SMCR_SMS_0;
-         //максимальное значение счетчика 
-	TIM3->ARR = 1000;
-        //включаем счетчик
-	TIM3->CR1 |= TIM_CR1_CEN ;
-	//обнуляем счетный регистр
-	TIM3->CNT = 0;
-}
-void TIM1_Encoder_init(void) {
-  // разрешаем тактирование таймера TIM1
-	RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
+/* Переход состояния (A << 1 | B): индекс - старое << 2 | новое. Код Грея
+   00-01-11-10 - вперед, обратно - назад, скачок через состояние - 0 */
+static const int8_t encoder_lut[16] = {0, 1, -1, 0, -1, 0, 0, 1, 1, 0, 0, -1, 0, -1, 1, 0};
+
+static volatile uint16_t encoder_samples[ENCODER_SW_SAMPLES];                    // IDR порта, пишет DMA
+static uint32_t encoder_sw_pos;                                                  // следующий неразобранный отсчет
+static uint16_t encoder_sw_prev;                                                 // последний разобранный отсчет
+static uint16_t encoder_sw_cnt[ENCODER_SW_COUNT];                                // программные счетчики, как CNT таймера
+
+static uint16_t encoder_last[ENCODER_COUNT];                                     // счетчик на прошлом тике
+static int32_t encoder_pos[ENCODER_COUNT];                                       // положение в отсчетах x4
+static int32_t encoder_rest[ENCODER_COUNT];                                      // отсчеты, не набравшие ENCODER_DIVIDER
+static uint32_t encoder_moved[ENCODER_COUNT];                                    // тик последнего движения
+static uint32_t encoder_tick;
+static uint8_t encoder_accel[ENCODER_ACCEL_STEPS];                               // множитель по мс на отсчет
+
+static void Encoder_SampleInit(void);
+static void Encoder_Sample(void);
+
+/* TIM1 занят сканированием матрицы клавиш (только у него есть запросы DMA2),
+   первый энкодер переехал на TIM2: PA15 - CH1, PB3 - CH2 */
+static void TIM2_Encoder_init(void) {
+  // разрешаем тактирование таймера TIM2
+	RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
   // конфигурируем выводы к которым подключается энкодер как входы с подтяжкой к питанию
-  GPIOA->MODER |= GPIO_MODER_MODER8_1 | GPIO_MODER_MODER9_1;    // Alternate function mode
-	GPIOA->AFR[1] |= (1 << GPIO_AFRH_AFSEL8_Pos) | (1 << GPIO_AFRH_AFSEL9_Pos);    // AF1 для TIM1
+	GPIOA->MODER &= ~GPIO_MODER_MODER15;
+  GPIOA->MODER |= GPIO_MODER_MODER15_1;                          // Alternate function mode
+	GPIOB->MODER &= ~GPIO_MODER_MODER3;
+  GPIOB->MODER |= GPIO_MODER_MODER3_1;
+	GPIOB->PUPDR = (GPIOB->PUPDR & ~GPIO_PUPDR_PUPDR3) | GPIO_PUPDR_PUPDR3_0;     // PA15 подтянут после сброса, PB3 нет
+	GPIOA->AFR[1] = (GPIOA->AFR[1] & ~GPIO_AFRH_AFSEL15) | (1 << GPIO_AFRH_AFSEL15_Pos);    // AF1 для TIM2
+	GPIOB->AFR[0] = (GPIOB->AFR[0] & ~GPIO_AFRL_AFSEL3) | (1 << GPIO_AFRL_AFSEL3_Pos);
 
         //настраиваем фильтр
-  TIM1->CCMR1 |= TIM_CCMR1_IC1F | TIM_CCMR1_IC2F;
+  TIM2->CCMR1 |= TIM_CCMR1_IC1F | TIM_CCMR1_IC2F;
         //настраиваем мультиплексор
-	TIM1->CCMR1 |= TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0;
+	TIM2->CCMR1 |= TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0;
         //сигнал TIxFP1 появиться по возрастающему фронту
-	TIM1->CCER &= ~(TIM_CCER_CC1P | TIM_CCER_CC2P);
-        //счет по обоим фронтам 
-	//TIM3->SMCR |= TIM_SMCR_SMS_0 | TIM_SMCR_SMS_1;
-			  //счет по одному фронту 
-	TIM1->SMCR |= TIM_SMCR_SMS_0;
-         //максимальное значение счетчика 
-	TIM1->ARR = 1000;
+	TIM2->CCER &= ~(TIM_CCER_CC1P | TIM_CCER_CC2P);
+        //счет по обоим фронтам обоих входов, x4
+	TIM2->SMCR = (TIM2->SMCR & ~TIM_SMCR_SMS) | TIM_SMCR_SMS_0 | TIM_SMCR_SMS_1;
+         //полный 16-битный круг: разность двух чтений - знаковое приращение
+	TIM2->ARR = 0xFFFF;
         //включаем счетчик
-	TIM1->CR1 |= TIM_CR1_CEN ;
+	TIM2->CR1 |= TIM_CR1_CEN ;
 	//обнуляем счетный регистр
-	TIM1->CNT = 0;
+	TIM2->CNT = 0;
+}
+void Encoder_init(void){
+	// кривая по умолчанию квадратичная: 1 + (MAX - 1) * ((KNEE - p) / KNEE)^2
+	for(uint32_t p = 0; p < ENCODER_ACCEL_STEPS; p++){
+		uint32_t k = (p < ENCODER_ACCEL_KNEE) ? ENCODER_ACCEL_KNEE - p : 0;
+		encoder_accel[p] = 1U + (ENCODER_ACCEL_MAX - 1U) * k * k / (ENCODER_ACCEL_KNEE * ENCODER_ACCEL_KNEE);
+	}
+	TIM2_Encoder_init();
+	Encoder_SampleInit();
 }
-void TIM4_Encoder_init(void){
-	//разрешаем тактирование таймера TIM3
-	RCC->APB1ENR |= RCC_APB1ENR_TIM4EN;
 
-       //конфигурируем выводы к которым подключается энкодер как входы с подтяжкой к питанию
-	GPIOB->MODER &= ~(GPIO_MODER_MODER6_0 | GPIO_MODER_MODER7_0);
-	GPIOB->MODER |= (GPIO_MODER_MODER6_1 | GPIO_MODER_MODER7_1);
-	GPIOB->PUPDR &= ~(GPIO_PUPDR_PUPDR6 | GPIO_PUPDR_PUPDR7);
-	GPIOB->AFR[0] &= ~(GPIO_AFRL_AFSEL6 | GPIO_AFRL_AFSEL7); 
-	GPIOB->AFR[0] |= (GPIO_AFRL_AFSEL6_1 | GPIO_AFRL_AFSEL7_1);	
-	
-         //настраиваем фильтр
-  TIM4->CCMR1 |= TIM_CCMR1_IC1F | TIM_CCMR1_IC2F;
-        //настраиваем мультиплексор
-	TIM4->CCMR1 |= TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0;
-        //сигнал TIxFP1 появиться по возрастающему фронту
-	TIM4->CCER &= ~(TIM_CCER_CC1P | TIM_CCER_CC2P);
-        //счет по обоим фронтам 
-	//TIM3->SMCR |= TIM_SMCR_SMS_0 | TIM_SMCR_SMS_1;
-			  //счет по одному фронту 
-	TIM4->SMCR |= TIM_SMCR_SMS_0;
-         //максимальное значение счетчика 
-	TIM4->ARR = 1000;
-        //включаем счетчик
-	TIM4->CR1 |= TIM_CR1_CEN ;
-	//обнуляем счетный регистр
-	TIM4->CNT = 0;
+/* TIM1 уже тикает с частотой строк матрицы (Keys_init), по CC2 DMA2
+   Stream2 канал 6 кладет IDR порта энкодеров в кольцо, без прерываний */
+static void Encoder_SampleInit(void){
+	encoder_sw_prev = ENCODER_SW_PORT->IDR;
+	for(uint32_t i = 0; i < ENCODER_SW_SAMPLES; i++) encoder_samples[i] = encoder_sw_prev;
+	encoder_sw_pos = 0;
+
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+	DMA2_Stream2->CR = 0;
+	while(DMA2_Stream2->CR & DMA_SxCR_EN);
+	DMA2_Stream2->PAR = (uint32_t)&ENCODER_SW_PORT->IDR;
+	DMA2_Stream2->M0AR = (uint32_t)encoder_samples;
+	DMA2_Stream2->NDTR = ENCODER_SW_SAMPLES;
+	DMA2_Stream2->CR = (6U << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_0 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 |
+	                   DMA_SxCR_MINC | DMA_SxCR_CIRC;                              // IDR -> память, 16 бит
+	DMA2->LIFCR = DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2;
+	DMA2_Stream2->CR |= DMA_SxCR_EN;
+
+	TIM1->CCR2 = 0;
+	TIM1->DIER |= TIM_DIER_CC2DE;
 }
-void Encoder_init(void){
-	TIM1_Encoder_init();
-	TIM3_Encoder_init();
-	TIM4_Encoder_init();
+
+/* Отсчеты с прошлого тика по порядку. Неизменившиеся отбрасываются
+   одним сравнением, для изменившихся - по таблице на каждый энкодер,
+   чьи выводы сменились */
+static void Encoder_Sample(void){
+	uint32_t end = (ENCODER_SW_SAMPLES - DMA2_Stream2->NDTR) % ENCODER_SW_SAMPLES;
+	uint16_t prev = encoder_sw_prev;
+	while(encoder_sw_pos != end){
+		uint16_t s = encoder_samples[encoder_sw_pos];
+		uint16_t diff = (s ^ prev) & ENCODER_SW_PINS;
+		encoder_sw_pos = (encoder_sw_pos + 1U) % ENCODER_SW_SAMPLES;
+		if(diff == 0) continue;
+		for(uint8_t e = 0; e < ENCODER_SW_COUNT; e++){
+			uint8_t pin = encoder_sw_pin[e];
+			if(!(diff & (3U << pin))) continue;
+			encoder_sw_cnt[e] += encoder_lut[(((prev >> pin) & 3U) << 2) | ((s >> pin) & 3U)];
+		}
+		prev = s;
+	}
+	encoder_sw_prev = prev;
+}
+
+/* Тик TIM10: разность счетчиков с прошлого тика. Прерывание тика -
+   единственный источник очереди энкодеров, дельты одного энкодера за
+   кадр складываются в один относительный CC */
+void Encoder_Tick(void){
+	++encoder_tick;
+	Encoder_Sample();
+	MIDI_Coalesce_Poll(MIDI_QUEUE_ENCODERS);
+	for(uint8_t e = 0; e < ENCODER_COUNT; e++){
+		uint16_t cnt = (e < ENCODER_HW_COUNT) ? encoder_tim[e]->CNT : encoder_sw_cnt[e - ENCODER_HW_COUNT];
+		int32_t delta = (int16_t)(cnt - encoder_last[e]);
+		uint32_t period;
+		if(delta == 0) continue;
+		encoder_last[e] = cnt;
+		encoder_pos[e] += delta;
+		// период - мс с прошлого движения на отсчет, после паузы множитель 1
+		period = (encoder_tick - encoder_moved[e]) / (uint32_t)((delta < 0) ? -delta : delta);
+		encoder_moved[e] = encoder_tick;
+		if(period >= ENCODER_ACCEL_STEPS) period = ENCODER_ACCEL_STEPS - 1U;
+		encoder_rest[e] += delta * encoder_accel[period];
+		delta = encoder_rest[e] / (int32_t)ENCODER_DIVIDER;
+		if(delta == 0) continue;
+		encoder_rest[e] -= delta * (int32_t)ENCODER_DIVIDER;
+		MIDI_Coalesce_Relative(MIDI_QUEUE_ENCODERS, 0, encoder_cc[e], delta);
+	}
+}
+
+int32_t Encoder_GetPosition(uint8_t enc){
+	return (enc < ENCODER_COUNT) ? encoder_pos[enc] : 0;
+}
+
+/* Своя кривая ускорения, ENCODER_ACCEL_STEPS множителей от 1 */
+void Encoder_SetAccelCurve(const uint8_t* curve){
+	for(uint32_t i = 0; i < ENCODER_ACCEL_STEPS; i++) encoder_accel[i] = curve[i] ? curve[i] : 1;
 }
@@ -0,0 +1,151 @@
+#include "hall.h"
+#include "analog.h"
+#include "midi_message.h"
+#include "midi_coalesce.h"
+
+#if HALL_KEYS
+
+#if HALL_KEYS > 32
+#error "HALL_KEYS does not fit the held-key bitmap"
+#endif
+
+static struct{
+	q15_t rest;                                                                    // отсчет в покое
+	q15_t bottom;                                                                  // отсчет в самом низу
+	int32_t smooth;                                                                // сглаженный отсчет << HALL_CAL_SHIFT
+	uint16_t travel[3];                                                            // ход сейчас, круг и два круга назад
+	uint16_t actuate, release;
+	uint16_t rt_sens;                                                              // 0 - rapid trigger выключен
+	uint16_t extreme;                                                              // rapid trigger: пик при нажатой, впадина при отпущенной
+	uint8_t down;
+	uint8_t pressure;                                                              // последнее отправленное давление
+	uint16_t at_cycle;                                                             // круг последнего давления
+}hall[HALL_KEYS];
+
+static uint32_t hall_held;                                                       // битовая карта нажатых клавиш
+static uint16_t hall_cycle;
+
+static void Hall_Aftertouch(void);
+
+void Hall_init(const q15_t* raw){
+	for(uint8_t k = 0; k < HALL_KEYS; k++){
+		hall[k].rest = raw[ANALOG_INDEX(k)];
+		hall[k].smooth = (int32_t)hall[k].rest << HALL_CAL_SHIFT;
+		hall[k].bottom = (hall[k].rest < 32767 - HALL_RANGE_MIN) ? hall[k].rest + HALL_RANGE_MIN : 32767;
+		hall[k].actuate = HALL_ACTUATE;
+		hall[k].release = HALL_RELEASE;
+		hall[k].rt_sens = 0;
+		hall[k].down = 0;
+	}
+}
+
+void Hall_SetThresholds(uint8_t key, uint16_t actuate, uint16_t release){
+	if(key >= HALL_KEYS || release >= actuate || actuate >= HALL_TRAVEL_MAX) return;
+	hall[key].actuate = actuate;
+	hall[key].release = release;
+}
+
+void Hall_SetRapidTrigger(uint8_t key, uint8_t on, uint16_t sensitivity){
+	if(key >= HALL_KEYS) return;
+	hall[key].rt_sens = on ? (sensitivity ? sensitivity : HALL_RT_SENSITIVITY) : 0;
+}
+
+uint16_t Hall_GetTravel(uint8_t key){
+	return (key < HALL_KEYS) ? hall[key].travel[0] : 0;
+}
+
+uint32_t Hall_GetHeld(void){
+	return hall_held;
+}
+
+/* Скорость - наклон хода за два круга в момент срабатывания */
+static void Hall_Press(uint8_t k){
+	int32_t slope = (int32_t)hall[k].travel[0] - hall[k].travel[2];
+	int32_t v = slope * 127 / (int32_t)HALL_SLOPE_MAX;
+	if(v < 1) v = 1;
+	if(v > 127) v = 127;
+	hall[k].down = 1;
+	hall[k].extreme = hall[k].travel[0];
+	hall[k].pressure = 0;
+	hall[k].at_cycle = hall_cycle;
+	hall_held |= 1UL << k;
+	MIDI_SendNoteOn(MIDI_QUEUE_ANALOG, HALL_CHANNEL, HALL_NOTE_FIRST + k, MIDI_Upscale(v, 7, 16));
+}
+
+static void Hall_Release(uint8_t k){
+	hall[k].down = 0;
+	hall[k].extreme = hall[k].travel[0];
+	hall_held &= ~(1UL << k);
+	MIDI_SendNoteOff(MIDI_QUEUE_ANALOG, HALL_CHANNEL, HALL_NOTE_FIRST + k, 0);
+}
+
+/* Круг мультиплексоров, PendSV. Ноты идут по кабелю
+   аналоговых контроллеров: у каждой очереди один источник */
+void Hall_Process(const q15_t* raw){
+	++hall_cycle;
+	for(uint8_t k = 0; k < HALL_KEYS; k++){
+		q15_t v = raw[ANALOG_INDEX(k)];
+		q15_t c;
+		uint32_t span;
+		uint16_t t;
+		// калибровка по крайним сглаженным значениям, ход - по сырому отсчету без задержки
+		hall[k].smooth += v - (hall[k].smooth >> HALL_CAL_SHIFT);
+		c = hall[k].smooth >> HALL_CAL_SHIFT;
+		if(c < hall[k].rest) hall[k].rest = c;
+		if(c > hall[k].bottom) hall[k].bottom = c;
+		if(v < hall[k].rest) v = hall[k].rest;
+		if(v > hall[k].bottom) v = hall[k].bottom;
+		span = hall[k].bottom - hall[k].rest;
+		t = span ? (uint32_t)(v - hall[k].rest) * HALL_TRAVEL_MAX / span : 0;
+		hall[k].travel[2] = hall[k].travel[1];
+		hall[k].travel[1] = hall[k].travel[0];
+		hall[k].travel[0] = t;
+
+		if(!hall[k].rt_sens){
+			if(!hall[k].down && t >= hall[k].actuate) Hall_Press(k);
+			else if(hall[k].down && t <= hall[k].release) Hall_Release(k);
+			continue;
+		}
+		// rapid trigger: важно только направление движения, не положение
+		if(hall[k].down){
+			if(t > hall[k].extreme) hall[k].extreme = t;
+			if(t < HALL_RT_DEADZONE || t + hall[k].rt_sens <= hall[k].extreme) Hall_Release(k);
+		}else{
+			if(t < hall[k].extreme) hall[k].extreme = t;
+			if(t >= HALL_RT_DEADZONE && t >= hall[k].extreme + hall[k].rt_sens) Hall_Press(k);
+		}
+	}
+#if HALL_AFTERTOUCH
+	Hall_Aftertouch();
+#endif
+}
+
+/* Давление - ход ниже точки срабатывания, 0..127. Обходятся только биты
+   нажатых клавиш, через CLZ; не чаще HALL_AT_INTERVAL кругов на клавишу,
+   в кадре USB остается последнее значение */
+static void Hall_Aftertouch(void){
+	uint32_t held = hall_held;
+	while(held){
+		uint8_t k = 31U - __CLZ(held);
+		uint16_t t = hall[k].travel[0];
+		uint32_t p = (t > hall[k].actuate) ? (t - hall[k].actuate) * 127U / (HALL_TRAVEL_MAX - hall[k].actuate) : 0;
+		uint8_t d = (p > hall[k].pressure) ? p - hall[k].pressure : hall[k].pressure - p;
+		held &= ~(1UL << k);
+		if((uint16_t)(hall_cycle - hall[k].at_cycle) < HALL_AT_INTERVAL) continue;
+		if(d < HALL_AT_DEADBAND && !(p == 0 && hall[k].pressure != 0)) continue;  // возврат в 0 уходит всегда
+		hall[k].pressure = p;
+		hall[k].at_cycle = hall_cycle;
+		MIDI_Coalesce_PolyPressure(MIDI_QUEUE_ANALOG, HALL_CHANNEL, HALL_NOTE_FIRST + k, MIDI_Upscale(p, 7, 32));
+	}
+}
+
+#else
+
+void Hall_init(const q15_t* raw){}
+void Hall_Process(const q15_t* raw){}
+void Hall_SetThresholds(uint8_t key, uint16_t actuate, uint16_t release){}
+void Hall_SetRapidTrigger(uint8_t key, uint8_t on, uint16_t sensitivity){}
+uint16_t Hall_GetTravel(uint8_t key){ return 0; }
+uint32_t Hall_GetHeld(void){ return 0; }
+
+#endif
@@ -0,0 +1,262 @@
+#include "keys.h"
+#include "main.h"
+
+/* Номера выводов строк и столбцов, в порядке клавиш */
+static const uint8_t keys_row_pin[KEYS_ROWS] = {0, 2, 3, 4, 5, 8, 9, 10};
+static const uint8_t keys_col_pin[KEYS_COLS] = {2, 8, 9, 10, 12, 13, 14, 15};
+
+#define KEYS_NO_NOTE 0xFF
+
+static void Keys_ScanInit(void);
+static void Keys_Events(uint8_t row, uint16_t old, uint16_t now);
+#if KEYS_DUAL_CONTACT
+static void Keys_Contacts(const volatile uint16_t* scan);
+#endif
+
+static uint32_t keys_strobe[KEYS_ROWS];                                          // слова BSRR: своя строка в 0, остальные в 1
+static volatile uint16_t keys_scan[KEYS_SCAN_DEPTH][KEYS_ROWS];                 // IDR столбцов, пишет DMA
+static Debounce keys_db[KEYS_ROWS];                                              // state - битовая карта нажатых клавиш строки
+static uint8_t keys_note[KEYS_ROWS][16];                                         // нота по номеру бита столбца
+static uint8_t keys_velocity[KEYS_VELOCITY_STEPS];                               // кривая: индекс Keys_VelocityIndex -> скорость
+#if KEYS_DUAL_CONTACT
+static uint32_t keys_last;                                                       // последний разобранный скан в кольце
+static uint32_t keys_time;                                                       // счетчик сканов, часы для контактов
+static uint16_t keys_raw1[KEYS_ROWS / 2], keys_raw2[KEYS_ROWS / 2];              // контакты в последнем скане, без антидребезга
+static Debounce keys_c1[KEYS_ROWS / 2];                                          // первый контакт с антидребезгом в сканах
+static uint16_t keys_pending[KEYS_ROWS / 2];                                     // первый контакт замкнулся, антидребезг еще идет
+static uint16_t keys_armed[KEYS_ROWS / 2];                                       // первый контакт замкнут, ждем второй
+static uint16_t keys_on[KEYS_ROWS / 2];                                          // нота звучит
+static uint32_t keys_t1[KEYS_ROWS / 2][16];                                      // скан замыкания первого контакта
+#endif
+
+void Debounce_init(Debounce* d, uint8_t ticks){
+	d->state = 0;
+	Debounce_SetTime(d, 0xFFFF, ticks);
+}
+
+/* Время дребезга для линий mask, 1..2^KEYS_DEBOUNCE_BITS-1 тиков */
+void Debounce_SetTime(Debounce* d, uint16_t mask, uint8_t ticks){
+	if(ticks < 1U) ticks = 1U;
+	if(ticks > (1U << KEYS_DEBOUNCE_BITS) - 1U) ticks = (1U << KEYS_DEBOUNCE_BITS) - 1U;
+	for(uint8_t b = 0; b < KEYS_DEBOUNCE_BITS; b++){
+		if(ticks & (1U << b)) d->reload[b] |= mask;
+		else d->reload[b] &= ~mask;
+		d->cnt[b] = (d->cnt[b] & ~mask) | (d->reload[b] & mask);
+	}
+}
+
+/* Очередной отсчет порта. Пока вход отличается от состояния, счетчик
+   линии уменьшается, совпал - перезаряжается. Дошел до нуля - состояние
+   линии меняется. Возвращает маску сменившихся линий */
+uint16_t Debounce_Update(Debounce* d, uint16_t raw){
+	uint16_t diff = raw ^ d->state;
+	uint16_t borrow = diff;
+	uint16_t nonzero = 0;
+	uint16_t toggle, hold;
+	for(uint8_t b = 0; b < KEYS_DEBOUNCE_BITS; b++){
+		uint16_t t = d->cnt[b];
+		d->cnt[b] = t ^ borrow;                                                      // вычитание единицы по всем линиям сразу
+		borrow &= ~t;
+		nonzero |= d->cnt[b];
+	}
+	toggle = diff & ~nonzero;
+	hold = diff & ~toggle;
+	for(uint8_t b = 0; b < KEYS_DEBOUNCE_BITS; b++)
+		d->cnt[b] = (d->cnt[b] & hold) | (d->reload[b] & ~hold);
+	d->state ^= toggle;
+	return toggle;
+}
+
+void Keys_init(void){
+	for(uint8_t r = 0; r < KEYS_ROWS; r++){
+		Debounce_init(&keys_db[r], KEYS_DEBOUNCE_MS * KEYS_TICK_HZ / 1000U);
+		for(uint8_t b = 0; b < 16U; b++) keys_note[r][b] = KEYS_NO_NOTE;
+		for(uint8_t c = 0; c < KEYS_COLS; c++) keys_note[r][keys_col_pin[c]] = KEYS_NOTE_FIRST + r / KEYS_CONTACTS * KEYS_COLS + c;
+	}
+	// кривая по умолчанию линейна по логарифму времени между FAST и SLOW
+	{
+		uint32_t fast = Keys_VelocityIndex(KEYS_VELOCITY_FAST_US);
+		uint32_t slow = Keys_VelocityIndex(KEYS_VELOCITY_SLOW_US);
+		for(uint32_t i = 0; i < KEYS_VELOCITY_STEPS; i++){
+			if(i <= fast) keys_velocity[i] = 127;
+			else if(i >= slow) keys_velocity[i] = 1;
+			else keys_velocity[i] = 127 - (i - fast) * 126U / (slow - fast);
+		}
+	}
+#if KEYS_DUAL_CONTACT
+	for(uint8_t p = 0; p < KEYS_ROWS / 2U; p++) Debounce_init(&keys_c1[p], KEYS_CONTACT_SCANS);
+#endif
+	Keys_ScanInit();
+
+	// TIM10 тикает с частотой опроса, таймеры APB2 на частоте ядра
+	RCC->APB2ENR |= RCC_APB2ENR_TIM10EN;
+	TIM10->PSC = SystemCoreClock / 1000000U - 1U;                                // 1 МГц
+	TIM10->ARR = 1000000U / KEYS_TICK_HZ - 1U;
+	TIM10->EGR = TIM_EGR_UG;
+	TIM10->SR = 0;
+	TIM10->DIER |= TIM_DIER_UIE;
+	// ниже USB: SOF может вытеснить опрос, очередь это допускает
+	HAL_NVIC_SetPriority(TIM1_UP_TIM10_IRQn, 1, 0);
+	HAL_NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);
+	TIM10->CR1 |= TIM_CR1_CEN;
+}
+
+/* TIM1 тикает с частотой строк. Переполнение: DMA2 Stream5 канал 6 пишет
+   в BSRR слово следующей строки. CC1 в последней четверти периода, когда
+   линии успокоились: DMA2 Stream1 канал 6 кладет IDR столбцов в кольцо.
+   Оба потока круговые и без прерываний, число клавиш их не меняет */
+static void Keys_ScanInit(void){
+	for(uint8_t r = 0; r < KEYS_ROWS; r++){
+		uint32_t pin = 1UL << keys_row_pin[r];
+		keys_strobe[r] = (pin << 16) | (KEYS_ROW_PINS & ~pin);
+	}
+
+	for(uint8_t s = 0; s < KEYS_SCAN_DEPTH; s++)
+		for(uint8_t r = 0; r < KEYS_ROWS; r++) keys_scan[s][r] = 0xFFFF;               // до первого прохода DMA все отпущено
+
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+	RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
+
+	DMA2_Stream5->CR = 0;
+	while(DMA2_Stream5->CR & DMA_SxCR_EN);
+	DMA2_Stream5->PAR = (uint32_t)&KEYS_ROW_PORT->BSRR;
+	DMA2_Stream5->M0AR = (uint32_t)keys_strobe;
+	DMA2_Stream5->NDTR = KEYS_ROWS;
+	DMA2_Stream5->CR = (6U << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+	                   DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_DIR_0;            // память -> BSRR, 32 бита
+
+	DMA2_Stream1->CR = 0;
+	while(DMA2_Stream1->CR & DMA_SxCR_EN);
+	DMA2_Stream1->PAR = (uint32_t)&KEYS_COL_PORT->IDR;
+	DMA2_Stream1->M0AR = (uint32_t)keys_scan;
+	DMA2_Stream1->NDTR = KEYS_SCAN_DEPTH * KEYS_ROWS;
+	DMA2_Stream1->CR = (6U << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 |
+	                   DMA_SxCR_MINC | DMA_SxCR_CIRC;                              // IDR -> память, 16 бит
+
+	DMA2->HIFCR = DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5;
+	DMA2->LIFCR = DMA_LIFCR_CTCIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTEIF1 | DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CFEIF1;
+	DMA2_Stream5->CR |= DMA_SxCR_EN;
+	DMA2_Stream1->CR |= DMA_SxCR_EN;
+
+	TIM1->CR1 = 0;
+	TIM1->PSC = 0;
+	TIM1->ARR = SystemCoreClock / (KEYS_SCAN_HZ * KEYS_ROWS) - 1U;
+	TIM1->CCR1 = TIM1->ARR * 3U / 4U;                                            // выход CC1 не используется, нужен только запрос DMA
+	TIM1->DIER |= TIM_DIER_UDE | TIM_DIER_CC1DE;                                 // CC2 - отсчеты энкодеров, см. encoder.c
+	TIM1->EGR = TIM_EGR_UG;                                                      // первый запрос по переполнению сразу ставит строку 0
+	TIM1->CR1 |= TIM_CR1_CEN;
+}
+
+void Keys_SetDebounce(uint8_t key, uint8_t ms){
+	if(key >= KEYS_COUNT) return;
+	for(uint8_t k = 0; k < KEYS_CONTACTS; k++)
+		Debounce_SetTime(&keys_db[key / KEYS_COLS * KEYS_CONTACTS + k], 1U << keys_col_pin[key % KEYS_COLS], ms * KEYS_TICK_HZ / 1000U);
+}
+
+/* Индекс кривой скорости по времени между контактами: степень двойки и
+   два следующих бита, 4 точки на октаву от 1 мкс до 130 мс */
+uint8_t Keys_VelocityIndex(uint32_t us){
+	uint32_t e;
+	if(us < 4U) return us;
+	e = 31U - __CLZ(us);
+	us = (e - 1U) * 4U + ((us >> (e - 2U)) & 3U);
+	return (us < KEYS_VELOCITY_STEPS) ? us : KEYS_VELOCITY_STEPS - 1U;
+}
+
+/* Своя кривая скорости, KEYS_VELOCITY_STEPS значений 1..127 */
+void Keys_SetVelocityCurve(const uint8_t* curve){
+	for(uint32_t i = 0; i < KEYS_VELOCITY_STEPS; i++) keys_velocity[i] = curve[i] ? (curve[i] & 0x7F) : 1;
+}
+
+uint16_t Keys_GetState(uint8_t row){
+	return (row < KEYS_ROWS) ? keys_db[row].state : 0;
+}
+
+/* Прерывание TIM10: последний полностью снятый скан матрицы, Note On по
+   нажатию и Note Off по отпусканию. Каждая строка - 16 столбцов разом.
+   Единственный источник очереди клавиш */
+void Keys_Tick(void){
+	uint32_t pos = KEYS_SCAN_DEPTH * KEYS_ROWS - DMA2_Stream1->NDTR;            // куда DMA пишет сейчас
+	uint32_t last = (pos / KEYS_ROWS + KEYS_SCAN_DEPTH - 1U) % KEYS_SCAN_DEPTH;  // предыдущий скан уже целый
+#if KEYS_DUAL_CONTACT
+	// все сканы с прошлого тика по порядку: время контакта с точностью до скана,
+	// Note On уходит в этом же тике. Тик позже чем через KEYS_SCAN_DEPTH сканов теряет круг
+	while(keys_last != last){
+		keys_last = (keys_last + 1U) % KEYS_SCAN_DEPTH;
+		++keys_time;
+		Keys_Contacts(keys_scan[keys_last]);
+	}
+	for(uint8_t p = 0; p < KEYS_ROWS / 2U; p++){
+		uint16_t up;
+		Debounce_Update(&keys_db[2 * p], ~keys_scan[last][2 * p] & KEYS_COL_PINS);
+		Debounce_Update(&keys_db[2 * p + 1], ~keys_scan[last][2 * p + 1] & KEYS_COL_PINS);
+		// отпущена: первый контакт разомкнут после обоих антидребезгов, второй - в скане.
+		// Один скан дребезга первого контакта клавишу не отпускает
+		up = ~(keys_db[2 * p].state | keys_c1[p].state | keys_raw2[p]) & KEYS_COL_PINS;
+		keys_armed[p] &= ~up;                                                        // недожатая клавиша
+		keys_pending[p] &= ~up;
+		Keys_Events(2 * p, keys_on[p], keys_on[p] & ~up);
+		keys_on[p] &= ~up;
+	}
+#else
+	for(uint8_t r = 0; r < KEYS_ROWS; r++){
+		uint16_t old = keys_db[r].state;
+		Debounce_Update(&keys_db[r], ~keys_scan[last][r] & KEYS_COL_PINS);
+		Keys_Events(r, old, keys_db[r].state);
+	}
+#endif
+}
+
+#if KEYS_DUAL_CONTACT
+/* Один скан пар строк. Замкнулся первый контакт - запоминаем время,
+   за ним второй - нота со скоростью по кривой. Все биты строки сразу.
+   Время идет от первого замыкания пачки дребезга: повторные замыкания в
+   пределах KEYS_BOUNCE_SCANS его не сдвигают, взводит клавишу только
+   первый контакт после антидребезга. Одиночная помеха старше пачки
+   забывается при следующем замыкании */
+static void Keys_Contacts(const volatile uint16_t* scan){
+	for(uint8_t p = 0; p < KEYS_ROWS / 2U; p++){
+		uint16_t s1 = ~scan[2 * p] & KEYS_COL_PINS;
+		uint16_t s2 = ~scan[2 * p + 1] & KEYS_COL_PINS;
+		uint32_t bits = s1 & ~keys_raw1[p] & ~keys_armed[p] & ~keys_on[p];
+		uint16_t toggle;
+		while(bits){
+			uint8_t bit = 31U - __CLZ(bits);
+			bits &= ~(1UL << bit);
+			if(!(keys_pending[p] & (1U << bit)) || keys_time - keys_t1[p][bit] > KEYS_BOUNCE_SCANS){
+				keys_t1[p][bit] = keys_time;
+				keys_pending[p] |= 1U << bit;
+			}
+		}
+		toggle = Debounce_Update(&keys_c1[p], s1);
+		keys_armed[p] |= toggle & keys_c1[p].state & keys_pending[p];
+		keys_armed[p] &= ~(toggle & ~keys_c1[p].state);                             // первый контакт устойчиво разомкнулся - нажатие не состоялось
+		keys_pending[p] &= ~toggle;
+		// очень быстрый удар: второй контакт раньше конца антидребезга первого
+		bits = s2 & ~keys_raw2[p] & (keys_armed[p] | keys_pending[p]);
+		keys_armed[p] &= ~bits;
+		keys_pending[p] &= ~bits;
+		keys_on[p] |= bits;
+		while(bits){
+			uint8_t bit = 31U - __CLZ(bits);
+			uint32_t us = (keys_time - keys_t1[p][bit]) * (1000000U / KEYS_SCAN_HZ);
+			bits &= ~(1UL << bit);
+			send_note_message(keys_note[2 * p][bit], ON, keys_velocity[Keys_VelocityIndex(us)]);
+		}
+		keys_raw1[p] = s1;
+		keys_raw2[p] = s2;
+	}
+}
+#endif
+
+/* Разница двух снимков строки: XOR дает сменившиеся линии, CLZ - номер
+   очередной из них, так обходятся только изменившиеся биты */
+static void Keys_Events(uint8_t row, uint16_t old, uint16_t now){
+	uint32_t diff = old ^ now;
+	while(diff){
+		uint8_t bit = 31U - __CLZ(diff);
+		diff &= ~(1UL << bit);
+		if(keys_note[row][bit] == KEYS_NO_NOTE) continue;
+		send_note_message(keys_note[row][bit], (now & (1U << bit)) ? ON : OFF, 0);
+	}
+}
@@ -23,9 +23,13 @@
 #include "adc.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-#include "usbd_hid.h"
+#include "usbd_midi_if.h"
 #include "stdbool.h"
 #include "encoder.h"
+#include "midi_queue.h"
+#include "midi_message.h"
+#include "keys.h"
+#include "analog.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -50,25 +54,19 @@ extern USBD_HandleTypeDef hUsbDeviceFS;
 uint8_t midiNoteOn[4];
 uint8_t midiNoteOff[4];
 float _err_estimate;
-uint16_t newEncoderValue = 0;
-uint16_t oldEncoderValue_1 = 0;
-uint16_t oldEncoderValue_3 = 0;
-uint16_t oldEncoderValue_4 = 0;
 NoteOnOff butON = {0x09, 0x90, 0, 0x7F};
-NoteOnOff Sensing = {MIDI_ACTIVE_SENSING, 0, 0, 0};
 uint16_t x = 0;
+uint32_t jr_frame = 0;
 
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 /* USER CODE BEGIN PFP */
-void encoder(uint16_t newEncoderValue, uint16_t* oldEncoderValue, uint8_t num, uint32_t CR);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
-enum {UP = 0,DOWN = 0x10}direction;
 /* USER CODE END 0 */
 
 /**
@@ -99,19 +97,23 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_ADC1_Init();
   MX_USB_DEVICE_Init();
+	Keys_init();
 	Encoder_init();
+	Analog_init();
   /* USER CODE BEGIN 2 */
   /* USER CODE END 2 */
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
   while (1)
   {
-		encoder(TIM1->CNT,&oldEncoderValue_1,1,TIM1->CR1);
-		encoder(TIM3->CNT,&oldEncoderValue_3,3,TIM3->CR1);
-		encoder(TIM4->CNT,&oldEncoderValue_4,4,TIM4->CR1);
 		++x;
-		if(x>65534)USBD_HID_SendReport(&hUsbDeviceFS, (uint8_t*)&Sensing, 4);
+		if(x>65534)MIDI_SendRealtime(MIDI_QUEUE_REALTIME, MIDI_ACTIVE_SENSING);
+		if(MIDI_GetFrame_FS() - jr_frame >= MIDI_JR_CLOCK_FRAMES){                // JR Clock - по кабелю главного цикла
+			jr_frame = MIDI_GetFrame_FS();
+			MIDI_SendJRClock(MIDI_QUEUE_REALTIME);
+		}
 		
     /* USER CODE END WHILE */
 		
@@ -166,34 +168,11 @@ void SystemClock_Config(void)
 }
 
 /* USER CODE BEGIN 4 */
-void send_cc_message(uint8_t channel, uint8_t controller, uint8_t value) {
-    uint8_t midi_data[4] = {0x0B, 0x00, 0x00, 0x00};  // MIDI CC сообщение
-    midi_data[1] = 0xB0 | (channel & 0x0F);  // статусный байт
-    midi_data[2] = controller & 0x7F;  // номер контроллера
-    midi_data[3] = value & 0x7F;  // значение фейдера
-		USBD_HID_SendReport(&hUsbDeviceFS, (uint8_t*)&midi_data, 4);// отправка MIDI сообщения
+void send_note_message(uint8_t note, ButState state, uint8_t velocity){
+	if(velocity == 0) velocity = butON.Speed;                                   // клавиша без второго контакта
+	if(state == ON) MIDI_SendNoteOn(MIDI_QUEUE_KEYS, butON.StateChannel & 0x0F, note, MIDI_Upscale(velocity & 0x7F, 7, 16));
+	else MIDI_SendNoteOff(MIDI_QUEUE_KEYS, butON.StateChannel & 0x0F, note, 0);
 }
-void send_note_message(uint8_t note){
-	butON.MIDINote = note;
-	USBD_HID_SendReport(&hUsbDeviceFS, (uint8_t*)&butON, 4);
-}
-void encoder(uint16_t newEncoderValue, uint16_t* oldEncoderValue, uint8_t num, uint32_t CR){
-		if(newEncoderValue != *oldEncoderValue){
-			direction =  CR & 0x10;
-			if(!direction) send_cc_message(0,num,1);
-			else send_cc_message(0,num,2);
-			HAL_Delay(100);
-			*oldEncoderValue = newEncoderValue;}
-}
-void delay_ms(uint16_t ms){
-   RCC->APB2ENR |= RCC_APB2ENR_TIM11EN;                                         // Включаем тактирование таймера
-	 ms=ms*10;
-	 TIM11->PSC = 8400-1;                                                         // устанавливаем предделитель 84,000,000 / 8399 = 10,000  0,0001s
-   TIM11->ARR = ms - 1;                                                         // устанавливаем значение переполнения таймера
-	 TIM11->EGR |= TIM_EGR_UG;                                                    // Генерируем Событие обновления для записи данных в регистры PSC и ARR
-   TIM11->CR1 |= TIM_CR1_CEN|TIM_CR1_OPM;                                       // Запускаем таймер записью бита CEN и устанавливаем режим Одного прохода установкой бита OPM
-	 while (TIM11->CR1 & TIM_CR1_CEN);                                            // Ждем окончания счета
-}// END_delay_ms
 
 /* USER CODE END 4 */
 
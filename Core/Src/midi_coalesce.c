@@ -0,0 +1,101 @@
+#include "midi_coalesce.h"
+#include "midi_message.h"
+#include "usbd_midi_if.h"
+
+/* Контроллер, ждущий конца кадра. Кабель задает очередь, ключ - вид, канал и номер */
+typedef struct{
+	uint8_t kind;
+	uint8_t channel;
+	uint8_t index;
+	uint32_t value;                                                                // значение или сумма дельт
+}MIDI_CoalesceSlot;
+
+/* Таблица на каждый кабель. Трогает ее только источник этой очереди,
+   поэтому блокировок не нужно, как и у самой очереди */
+static struct{
+	MIDI_CoalesceSlot slot[MIDI_COALESCE_SLOTS];
+	uint32_t used;
+	uint32_t frame;                                                                // кадр USB, в котором копится таблица
+	uint32_t saved;                                                                // сколько сообщений поглощено
+}coalesce[MIDI_QUEUE_COUNT];
+
+static bool MIDI_Coalesce_Put(MIDI_QueueId q, uint8_t kind, uint8_t channel, uint8_t index, uint32_t value){
+	MIDI_CoalesceSlot* s = coalesce[q].slot;
+	uint32_t i;
+	MIDI_Coalesce_Poll(q);
+	for(i = 0; i < coalesce[q].used; i++){
+		if(s[i].kind == kind && s[i].channel == channel && s[i].index == index){
+			s[i].value = (kind == MIDI_COALESCE_RELATIVE) ? s[i].value + value : value;
+			++coalesce[q].saved;
+			return true;
+		}
+	}
+	if(coalesce[q].used == MIDI_COALESCE_SLOTS) MIDI_Coalesce_Flush(q);         // таблица полна - отдаем раньше времени
+	if(coalesce[q].used == MIDI_COALESCE_SLOTS) return false;                    // и очередь тоже полна
+	s = &s[coalesce[q].used++];
+	s->kind = kind;
+	s->channel = channel;
+	s->index = index;
+	s->value = value;
+	return true;
+}
+
+/* Абсолютный CC: за кадр уходит только последнее значение */
+bool MIDI_Coalesce_Control(MIDI_QueueId q, uint8_t channel, uint8_t index, uint32_t value){
+	return MIDI_Coalesce_Put(q, MIDI_COALESCE_CONTROL, channel & 0x0F, index & 0x7F, value);
+}
+
+/* 14-битный CC, index 0..31: за кадр уходит одна пара MSB/LSB */
+bool MIDI_Coalesce_Control14(MIDI_QueueId q, uint8_t channel, uint8_t index, uint32_t value){
+	return MIDI_Coalesce_Put(q, MIDI_COALESCE_CONTROL14, channel & 0x0F, index & 0x1F, value);
+}
+
+/* Относительный контроллер: за кадр уходит сумма приращений */
+bool MIDI_Coalesce_Relative(MIDI_QueueId q, uint8_t channel, uint8_t index, int32_t delta){
+	return MIDI_Coalesce_Put(q, MIDI_COALESCE_RELATIVE, channel & 0x0F, index & 0x7F, (uint32_t)delta);
+}
+
+/* Давление клавиши: за кадр уходит только последнее значение */
+bool MIDI_Coalesce_PolyPressure(MIDI_QueueId q, uint8_t channel, uint8_t note, uint32_t value){
+	return MIDI_Coalesce_Put(q, MIDI_COALESCE_POLY_PRESSURE, channel & 0x0F, note & 0x7F, value);
+}
+
+/* Отдает накопленное в очередь, если с момента первой записи начался новый
+   кадр. Источник вызывает ее регулярно, даже когда ему нечего отправить */
+void MIDI_Coalesce_Poll(MIDI_QueueId q){
+	uint32_t frame = MIDI_GetFrame_FS();
+	if(frame == coalesce[q].frame) return;
+	MIDI_Coalesce_Flush(q);
+	coalesce[q].frame = frame;
+}
+
+/* Отдает все накопленное в очередь в порядке первой записи. Вызывается и
+   перед каждой нотой, Program Change и т.п. того же кабеля, чтобы CC не
+   обгоняли их и не отставали от них */
+void MIDI_Coalesce_Flush(MIDI_QueueId q){
+	MIDI_CoalesceSlot* s = coalesce[q].slot;
+	uint32_t used = coalesce[q].used;
+	uint32_t i, k;
+	coalesce[q].used = 0;                                                          // MIDI_Send* сами зовут Flush, вложенный вызов увидит пустую таблицу
+	for(i = 0; i < used; i++){
+		bool ok;
+		int32_t rest;
+		switch(s[i].kind){
+			case MIDI_COALESCE_CONTROL14:     ok = MIDI_SendControl14(q, s[i].channel, s[i].index, s[i].value); break;
+			case MIDI_COALESCE_RELATIVE:                                              // неушедшая часть суммы остается в слоте
+				rest = MIDI_SendRelative(q, s[i].channel, s[i].index, (int32_t)s[i].value);
+				s[i].value = (uint32_t)rest;
+				ok = (rest == 0);
+				break;
+			case MIDI_COALESCE_POLY_PRESSURE: ok = MIDI_SendPolyPressure(q, s[i].channel, s[i].index, s[i].value); break;
+			default:                          ok = MIDI_SendControl(q, s[i].channel, s[i].index, s[i].value); break;
+		}
+		if(!ok) break;                                                             // очередь полна - остаток ждет следующего раза
+	}
+	for(k = 0; i < used; i++, k++) s[k] = s[i];
+	coalesce[q].used = k;
+}
+
+uint32_t MIDI_Coalesce_Saved(MIDI_QueueId q){
+	return coalesce[q].saved;
+}
@@ -0,0 +1,581 @@
+#include "midi_message.h"
+#include "midi_queue.h"
+#include "midi_coalesce.h"
+#include "stm32f4xx_hal.h"
+#include "usbd_midi_if.h"
+#include <string.h>
+
+#define SYSEX_CHUNK_MAX 48U                                                      // 16 пакетов по 3 байта
+
+/* Передаваемый SysEx: запускает главный цикл, кодирует SOF прерывание.
+   Данные читаются по 3 байта прямо из источника, целиком не буферизуются */
+static struct{
+	MIDI_SysExReader reader;
+	const uint8_t* data;
+	uint32_t len;                                                                  // длина без F0/F7
+	uint32_t pos;                                                                  // позиция в потоке F0 данные F7
+	uint8_t cable;
+	volatile bool busy;
+}sysex_tx;
+
+/* Формат потока выбирает хост альтернативной настройкой MS интерфейса */
+static volatile MIDI_Protocol midi_protocol = MIDI_PROTOCOL_1_0;
+
+static volatile MIDI_RelativeEncoding midi_relative = MIDI_RELATIVE_TWOS_COMPLEMENT;
+
+/* Что приемник MIDI 1.0 уже знает о 14-битных значениях: бит 15 - значение
+   отправлено. Пишет только источник своей очереди */
+static uint16_t midi_cc14[MIDI_QUEUE_COUNT][16][32];
+static struct{
+	uint16_t param;                                                                // бит 15 - выбран, бит 14 - NRPN, номер 14 бит
+	uint16_t value;                                                                // бит 15 - отправлено
+}midi_param[MIDI_QUEUE_COUNT][16];
+static volatile uint8_t midi_epoch;                                              // номер потока, растет при смене протокола
+static uint8_t midi_cache_epoch[MIDI_QUEUE_COUNT];                               // поток, к которому относятся таблицы очереди
+
+/* Длина UMP в 32-битных словах по Message Type */
+static const uint8_t ump_words[16] = {1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4};
+
+/* Переключение протокола, вызывается из прерывания USB по SET_INTERFACE.
+   Для JR Timestamp запускается счетчик тактов DWT. Таблицы 14-битных
+   значений здесь не трогаются: их пишут прерывания источников, и сброс
+   посреди их записи потерялся бы. Их чистит сам источник по midi_epoch */
+void MIDI_SetProtocol(MIDI_Protocol protocol){
+	if(protocol == MIDI_PROTOCOL_2_0){
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	}
+	midi_protocol = protocol;
+	++midi_epoch;
+}
+
+/* Протокол, в котором собирается сообщение, и номер его потока одним
+   снимком; номер уходит в очередь вместе с сообщением. SET_INTERFACE
+   между снимком и записью в очередь меняет номер, и потребитель
+   выбросит такое сообщение, а не прочтет его в чужом формате */
+static MIDI_Protocol MIDI_Format(uint8_t* epoch){
+	MIDI_Protocol protocol;
+	do{
+		*epoch = midi_epoch;
+		protocol = midi_protocol;
+	}while(*epoch != midi_epoch);
+	return protocol;
+}
+
+/* Новый поток - приемник ничего не знает. Вызывается источником очереди q
+   до чтения таблиц, поэтому с его же записью не пересекается */
+static void MIDI_CacheCheck(MIDI_QueueId q, uint8_t epoch){
+	if(midi_cache_epoch[q] == epoch) return;
+	memset(midi_cc14[q], 0, sizeof(midi_cc14[q]));
+	memset(midi_param[q], 0, sizeof(midi_param[q]));
+	midi_cache_epoch[q] = epoch;
+}
+
+MIDI_Protocol MIDI_GetProtocol(void){
+	return midi_protocol;
+}
+
+uint8_t MIDI_GetEpoch(void){
+	return midi_epoch;
+}
+
+void MIDI_SetRelativeEncoding(MIDI_RelativeEncoding encoding){
+	midi_relative = encoding;
+}
+
+MIDI_RelativeEncoding MIDI_GetRelativeEncoding(void){
+	return midi_relative;
+}
+
+/* Масштабирование Min-Center-Max из спецификации MIDI 2.0: 0, середина и
+   максимум переходят в 0, середину и максимум нового разрешения */
+uint32_t MIDI_Upscale(uint32_t value, uint8_t src_bits, uint8_t dst_bits){
+	uint8_t scale = dst_bits - src_bits;
+	uint8_t repeat_bits = src_bits - 1U;
+	uint32_t center = 1UL << repeat_bits;
+	uint32_t shifted, repeat;
+	if(dst_bits <= src_bits) return value >> (src_bits - dst_bits);
+	shifted = value << scale;
+	if(value <= center) return shifted;
+	repeat = value & (center - 1U);                                                // младшие биты повторяются до заполнения
+	repeat = (scale > repeat_bits) ? repeat << (scale - repeat_bits) : repeat >> (repeat_bits - scale);
+	while(repeat != 0){
+		shifted |= repeat;
+		repeat >>= repeat_bits;
+	}
+	return shifted;
+}
+
+/* Сколько слов очереди занимает сообщение, начинающееся словом first.
+   Потребитель по этой длине не разрезает UMP и группы между передачами,
+   метка группы считается вместе с группой */
+uint32_t MIDI_WordCount(uint32_t first){
+	if(MIDI_IS_GROUP(first)) return 1U + ((first >> 8) & 0xFFU);
+	if(midi_protocol == MIDI_PROTOCOL_1_0) return 1;
+	return ump_words[first >> 28];
+}
+
+/* JR Timestamp, 16 бит в тиках 1/31250 с: кадр USB - ровно 31,25 тика,
+   внутри кадра - такты ядра от его SOF. Счет в четвертях тика, переход
+   через 2^32 не дает скачка в младших 16 битах */
+static uint32_t MIDI_JRTimestamp(void){
+	uint32_t cycles;
+	uint32_t frame = MIDI_GetFrameTime_FS(&cycles);
+	uint32_t quarter = cycles / (SystemCoreClock / 125000U);
+	if(quarter > 124U) quarter = 124U;                                            // SOF пропущен - не залезать в следующий кадр
+	return ((frame * 125U + quarter) >> 2) & 0xFFFFU;
+}
+
+/* Канальные сообщения сначала выталкивают накопленные CC своего кабеля
+   (MIDI_Coalesce_Flush), так порядок в кабеле не нарушается */
+
+/* Нота: в MIDI 1.0 скорость ужимается до 7 бит, в UMP уходит MT4 с
+   16-битной скоростью и меткой времени момента вызова */
+static bool MIDI_SendNote(MIDI_QueueId q, uint8_t status, uint8_t note, uint16_t velocity){
+	uint8_t tag;
+	uint32_t ump[3];
+	uint32_t n = 0;
+	MIDI_Coalesce_Flush(q);
+	if(MIDI_Format(&tag) == MIDI_PROTOCOL_1_0){
+		uint8_t v = velocity >> 9;
+		if(v == 0 && (status & 0xF0) == 0x90) v = 1;                                 // Note On с нулем - это Note Off
+		return MIDI_Queue_Push(q, MIDI_PACKET((q << 4) | (status >> 4), status, note & 0x7F, v), tag);
+	}
+#if MIDI_UMP_JR_TIMESTAMPS
+	ump[n++] = MIDI_UMP(MIDI_MT_UTILITY, 0, 0x20, 0, 0) | MIDI_JRTimestamp();
+#endif
+	ump[n++] = MIDI_UMP(MIDI_MT_MIDI2_VOICE, q, status, note & 0x7F, 0);
+	ump[n++] = (uint32_t)velocity << 16;
+	return MIDI_Queue_PushN(q, ump, n, tag);
+}
+
+bool MIDI_SendNoteOn(MIDI_QueueId q, uint8_t channel, uint8_t note, uint16_t velocity){
+	if(velocity == 0) velocity = 1;
+	return MIDI_SendNote(q, 0x90 | (channel & 0x0F), note, velocity);
+}
+
+bool MIDI_SendNoteOff(MIDI_QueueId q, uint8_t channel, uint8_t note, uint16_t velocity){
+	return MIDI_SendNote(q, 0x80 | (channel & 0x0F), note, velocity);
+}
+
+/* Control Change с 32-битным значением, в MIDI 1.0 остаются старшие 7 бит */
+bool MIDI_SendControl(MIDI_QueueId q, uint8_t channel, uint8_t index, uint32_t value){
+	uint8_t tag;
+	uint8_t status = 0xB0 | (channel & 0x0F);
+	uint32_t ump[2];
+	MIDI_Coalesce_Flush(q);
+	if(MIDI_Format(&tag) == MIDI_PROTOCOL_1_0)
+		return MIDI_Queue_Push(q, MIDI_PACKET((q << 4) | MIDI_CIN_CONTROL_CHANGE, status, index & 0x7F, value >> 25), tag);
+	ump[0] = MIDI_UMP(MIDI_MT_MIDI2_VOICE, q, status, index & 0x7F, 0);
+	ump[1] = value;
+	return MIDI_Queue_PushN(q, ump, 2, tag);
+}
+
+/* Кладет в очередь пакеты MIDI 1.0, больше одного - группой за меткой p[0] */
+static bool MIDI_PushGroup(MIDI_QueueId q, uint32_t* p, uint32_t n, uint8_t tag){
+	if(n == 2) return MIDI_Queue_Push(q, p[1], tag);
+	p[0] = MIDI_GROUP(n - 1U);
+	return MIDI_Queue_PushN(q, p, n, tag);
+}
+
+/* 14-битный CC, index 0..31. В MIDI 1.0 - MSB на index и LSB на index + 32
+   из старших 14 бит value. Неизменная половина не отправляется, только
+   после MSB всегда идет LSB: приемник по MSB сбрасывает LSB. Пара уходит
+   одной передачей USB. В UMP - один CC с 32 битами */
+bool MIDI_SendControl14(MIDI_QueueId q, uint8_t channel, uint8_t index, uint32_t value){
+	uint8_t tag;
+	uint8_t status = 0xB0 | (channel & 0x0F);
+	uint16_t v = value >> 18;
+	uint16_t* last = &midi_cc14[q][channel & 0x0F][index & 0x1F];
+	uint32_t p[3];
+	uint32_t n = 1;
+	if(MIDI_Format(&tag) != MIDI_PROTOCOL_1_0) return MIDI_SendControl(q, channel, index & 0x1F, value);
+	MIDI_CacheCheck(q, tag);
+	if(*last == (v | 0x8000U)) return true;
+	MIDI_Coalesce_Flush(q);
+	if(!(*last & 0x8000U) || ((*last ^ v) & 0x3F80U))
+		p[n++] = MIDI_PACKET((q << 4) | MIDI_CIN_CONTROL_CHANGE, status, index & 0x1F, v >> 7);
+	p[n++] = MIDI_PACKET((q << 4) | MIDI_CIN_CONTROL_CHANGE, status, (index & 0x1F) + 32U, v & 0x7F);
+	if(!MIDI_PushGroup(q, p, n, tag)) return false;
+	*last = v | 0x8000U;
+	return true;
+}
+
+/* RPN/NRPN с 14-битным Data Entry (CC 6 и 38). Номер параметра (CC
+   101/100 или 99/98) не повторяется, пока на канале выбран тот же,
+   данные - по правилам MIDI_SendControl14. Вся посылка - одна группа.
+   В UMP - Registered/Assignable Controller: банк и индекс - номер, 32 бита */
+bool MIDI_SendParameter(MIDI_QueueId q, uint8_t channel, MIDI_ParamType type, uint16_t param, uint32_t value){
+	uint8_t tag;
+	uint8_t status = 0xB0 | (channel & 0x0F);
+	uint16_t sel = 0x8000U | ((type == MIDI_PARAM_NRPN) ? 0x4000U : 0) | (param & 0x3FFFU);
+	uint16_t v = value >> 18;
+	uint32_t p[5];
+	uint32_t n = 1;
+	if(MIDI_Format(&tag) != MIDI_PROTOCOL_1_0){
+		MIDI_Coalesce_Flush(q);
+		p[0] = MIDI_UMP(MIDI_MT_MIDI2_VOICE, q, (((type == MIDI_PARAM_NRPN) ? MIDI2_ASSIGN_CTRL : MIDI2_REG_CTRL) << 4) | (channel & 0x0F),
+		                (param >> 7) & 0x7F, param & 0x7F);
+		p[1] = value;
+		return MIDI_Queue_PushN(q, p, 2, tag);
+	}
+	channel &= 0x0F;
+	MIDI_CacheCheck(q, tag);
+	if(midi_param[q][channel].param != sel){
+		p[n++] = MIDI_PACKET((q << 4) | MIDI_CIN_CONTROL_CHANGE, status, (type == MIDI_PARAM_NRPN) ? 99 : 101, (param >> 7) & 0x7F);
+		p[n++] = MIDI_PACKET((q << 4) | MIDI_CIN_CONTROL_CHANGE, status, (type == MIDI_PARAM_NRPN) ? 98 : 100, param & 0x7F);
+	}else if(midi_param[q][channel].value == (v | 0x8000U)){
+		return true;
+	}
+	MIDI_Coalesce_Flush(q);
+	if(n > 1 || !(midi_param[q][channel].value & 0x8000U) || ((midi_param[q][channel].value ^ v) & 0x3F80U))
+		p[n++] = MIDI_PACKET((q << 4) | MIDI_CIN_CONTROL_CHANGE, status, 6, v >> 7);
+	p[n++] = MIDI_PACKET((q << 4) | MIDI_CIN_CONTROL_CHANGE, status, 38, v & 0x7F);
+	if(!MIDI_PushGroup(q, p, n, tag)) return false;
+	midi_param[q][channel].param = sel;
+	midi_param[q][channel].value = v | 0x8000U;
+	return true;
+}
+
+/* Poly Key Pressure: в MIDI 1.0 CIN 0xA с 7 битами, в UMP - 32 бита */
+bool MIDI_SendPolyPressure(MIDI_QueueId q, uint8_t channel, uint8_t note, uint32_t value){
+	uint8_t tag;
+	uint8_t status = 0xA0 | (channel & 0x0F);
+	uint32_t ump[2];
+	MIDI_Coalesce_Flush(q);
+	if(MIDI_Format(&tag) == MIDI_PROTOCOL_1_0)
+		return MIDI_Queue_Push(q, MIDI_PACKET((q << 4) | MIDI_CIN_POLY_PRESSURE, status, note & 0x7F, value >> 25), tag);
+	ump[0] = MIDI_UMP(MIDI_MT_MIDI2_VOICE, q, status, note & 0x7F, 0);
+	ump[1] = value;
+	return MIDI_Queue_PushN(q, ump, 2, tag);
+}
+
+/* Приращение энкодера. В UMP - Relative Assignable Controller (банк 0) со
+   знаковой 32-битной дельтой. В MIDI 1.0 - CC в выбранном кодировании,
+   дельта больше MIDI_RELATIVE_DELTA_MAX режется на несколько CC, по
+   MIDI_RELATIVE_SPLIT в группе. Возвращает часть дельты, которой не
+   хватило места в очереди: 0 - ушло все */
+int32_t MIDI_SendRelative(MIDI_QueueId q, uint8_t channel, uint8_t index, int32_t delta){
+	uint8_t tag;
+	uint32_t p[MIDI_RELATIVE_SPLIT + 1U];
+	if(delta == 0) return 0;
+	MIDI_Coalesce_Flush(q);
+	if(MIDI_Format(&tag) != MIDI_PROTOCOL_1_0){
+		p[0] = MIDI_UMP(MIDI_MT_MIDI2_VOICE, q, (MIDI2_REL_ASSIGN_CTRL << 4) | (channel & 0x0F), 0, index & 0x7F);
+		p[1] = (uint32_t)delta;
+		return MIDI_Queue_PushN(q, p, 2, tag) ? 0 : delta;
+	}
+	while(delta != 0){
+		int32_t rest = delta;
+		uint32_t n = 1;
+		while(rest != 0 && n <= MIDI_RELATIVE_SPLIT){
+			int32_t d = rest;
+			uint8_t value;
+			if(d > MIDI_RELATIVE_DELTA_MAX) d = MIDI_RELATIVE_DELTA_MAX;
+			if(d < -MIDI_RELATIVE_DELTA_MAX) d = -MIDI_RELATIVE_DELTA_MAX;
+			switch(midi_relative){
+				case MIDI_RELATIVE_BINARY_OFFSET:  value = 64 + d; break;
+				case MIDI_RELATIVE_SIGN_MAGNITUDE: value = (d < 0) ? 0x40 | -d : d; break;
+				default:                           value = d & 0x7F; break;
+			}
+			p[n++] = MIDI_PACKET((q << 4) | MIDI_CIN_CONTROL_CHANGE, 0xB0 | (channel & 0x0F), index & 0x7F, value);
+			rest -= d;
+		}
+		if(!MIDI_PushGroup(q, p, n, tag)) return delta;
+		delta = rest;
+	}
+	return 0;
+}
+
+/* Assignable Per-Note Controller, есть только в UMP. В MIDI 1.0 не отправляется */
+bool MIDI_SendPerNoteControl(MIDI_QueueId q, uint8_t channel, uint8_t note, uint8_t index, uint32_t value){
+	uint8_t tag;
+	uint32_t ump[2];
+	if(MIDI_Format(&tag) == MIDI_PROTOCOL_1_0) return false;
+	MIDI_Coalesce_Flush(q);
+	ump[0] = MIDI_UMP(MIDI_MT_MIDI2_VOICE, q, (MIDI2_ASSIGN_PER_NOTE_CTRL << 4) | (channel & 0x0F), note & 0x7F, index);
+	ump[1] = value;
+	return MIDI_Queue_PushN(q, ump, 2, tag);
+}
+
+/* JR Clock, только в UMP: время отправителя для JR Timestamp нот */
+bool MIDI_SendJRClock(MIDI_QueueId q){
+	uint8_t tag;
+	if(MIDI_Format(&tag) == MIDI_PROTOCOL_1_0) return true;
+	return MIDI_Queue_Push(q, MIDI_UMP(MIDI_MT_UTILITY, 0, 0x10, 0, 0) | MIDI_JRTimestamp(), tag);
+}
+
+bool MIDI_SendRealtime(MIDI_QueueId q, uint8_t status){
+	uint8_t tag;
+	if(MIDI_Format(&tag) == MIDI_PROTOCOL_1_0)
+		return MIDI_Queue_Push(q, MIDI_PACKET((q << 4) | MIDI_CIN_SINGLE_BYTE, status, 0, 0), tag);
+	return MIDI_Queue_Push(q, MIDI_UMP(MIDI_MT_SYSTEM, q, status, 0, 0), tag);
+}
+
+/* Разбор одного пакета, возвращает 0 если пакет не несет сообщения */
+static uint8_t MIDI_DecodePacket(const uint8_t* p, MIDI_Message* msg){
+	uint8_t cin = p[0] & 0x0F;
+	uint8_t status = p[1];
+	msg->Cable = p[0] >> 4;
+	msg->Status = status;
+	msg->Channel = status & 0x0F;
+	msg->Data1 = p[2] & 0x7F;
+	msg->Data2 = p[3] & 0x7F;
+	msg->Value = msg->Data2;
+	switch(cin){
+		case MIDI_CIN_NOTE_OFF:
+		case MIDI_CIN_NOTE_ON:
+		case MIDI_CIN_POLY_PRESSURE:
+		case MIDI_CIN_CONTROL_CHANGE:
+		case MIDI_CIN_PROGRAM_CHANGE:
+		case MIDI_CIN_CHANNEL_PRESSURE:
+		case MIDI_CIN_PITCH_BEND:
+			if((status & 0xF0) != (uint8_t)(cin << 4)) return 0;                // CIN и статус не совпадают
+			msg->Type = MIDI_MSG_NOTE_OFF + (cin - MIDI_CIN_NOTE_OFF);
+			if(msg->Type == MIDI_MSG_NOTE_ON && msg->Data2 == 0) msg->Type = MIDI_MSG_NOTE_OFF;
+			else if(msg->Type == MIDI_MSG_PITCH_BEND) msg->Value = msg->Data1 | ((uint16_t)msg->Data2 << 7);
+			return 1;
+		case MIDI_CIN_SYSCOMMON_2:
+		case MIDI_CIN_SYSCOMMON_3:
+		case MIDI_CIN_SYSEX_END_1:
+		case MIDI_CIN_SINGLE_BYTE:
+			if(status >= 0xF8){
+				msg->Type = MIDI_MSG_REALTIME;
+				return 1;
+			}
+			if(status > 0xF0 && status != 0xF7){
+				msg->Type = MIDI_MSG_SYSTEM_COMMON;
+				return 1;
+			}
+			return 0;
+		default:                                                                   // служебные и зарезервированные CIN
+			return 0;
+	}
+}
+
+/* Разбор MT4 MIDI 2.0 Channel Voice. Data1/Data2 - 7-битный вид сообщения,
+   Value - полное разрешение */
+static uint8_t MIDI_DecodeVoice2(uint32_t w0, uint32_t w1, MIDI_Message* msg){
+	uint8_t status = (w0 >> 16) & 0xFF;
+	msg->Cable = (w0 >> 24) & 0x0F;
+	msg->Status = status;
+	msg->Channel = status & 0x0F;
+	msg->Data1 = (w0 >> 8) & 0x7F;
+	msg->Data2 = w1 >> 25;
+	msg->Value = w1;
+	switch(status >> 4){
+		case MIDI_CIN_NOTE_OFF:
+		case MIDI_CIN_NOTE_ON:
+			msg->Type = MIDI_MSG_NOTE_OFF + ((status >> 4) - MIDI_CIN_NOTE_OFF);
+			msg->Value = w1 >> 16;
+			if(msg->Type == MIDI_MSG_NOTE_ON && msg->Data2 == 0) msg->Data2 = 1;      // в MIDI 2.0 нулевая скорость не Note Off
+			return 1;
+		case MIDI_CIN_POLY_PRESSURE:
+		case MIDI_CIN_CONTROL_CHANGE:
+			msg->Type = MIDI_MSG_NOTE_OFF + ((status >> 4) - MIDI_CIN_NOTE_OFF);
+			return 1;
+		case MIDI_CIN_PROGRAM_CHANGE:
+			msg->Type = MIDI_MSG_PROGRAM_CHANGE;
+			msg->Data1 = (w1 >> 24) & 0x7F;
+			msg->Data2 = 0;
+			return 1;
+		case MIDI_CIN_CHANNEL_PRESSURE:
+			msg->Type = MIDI_MSG_CHANNEL_PRESSURE;
+			msg->Data1 = w1 >> 25;
+			msg->Data2 = 0;
+			return 1;
+		case MIDI_CIN_PITCH_BEND:
+			msg->Type = MIDI_MSG_PITCH_BEND;
+			msg->Data1 = (w1 >> 18) & 0x7F;
+			return 1;
+		default:                                                                   // RPN/NRPN и per-note контроллеры не разбираются
+			return 0;
+	}
+}
+
+/* Разбирает принятый с OUT эндпоинта буфер прямо на месте, за время
+   не больше 16 пакетов на 64-байтную передачу. Байты SysEx одного кабеля
+   собираются в кусок не длиннее одной передачи */
+void MIDI_ParsePackets(const uint8_t* buf, uint32_t len){
+	MIDI_Message msg;
+	uint8_t chunk[SYSEX_CHUNK_MAX];
+	uint32_t chunk_len = 0;
+	uint8_t chunk_cable = 0, chunk_flags = 0;
+	for(uint32_t i = 0; i + 4U <= len; i += 4U){
+		const uint8_t* p = &buf[i];
+		uint8_t cin = p[0] & 0x0F;
+		uint8_t n = (cin == MIDI_CIN_SYSEX_START) ? 3 : (cin >= MIDI_CIN_SYSEX_END_1 && cin <= MIDI_CIN_SYSEX_END_3) ? cin - 4 : 0;
+		if(cin == MIDI_CIN_SYSEX_END_1 && p[1] != 0xF7) n = 0;                      // однобайтовое System Common
+		if(n == 0){
+			if(MIDI_DecodePacket(p, &msg)) MIDI_RxCallback(&msg);
+			continue;
+		}
+		if(chunk_len != 0 && chunk_cable != (p[0] >> 4)){
+			MIDI_SysExRxCallback(chunk_cable, chunk, chunk_len, chunk_flags);
+			chunk_len = 0;
+		}
+		if(chunk_len == 0){
+			chunk_cable = p[0] >> 4;
+			chunk_flags = 0;
+		}
+		for(uint8_t k = 1; k <= n; k++){
+			if(p[k] == 0xF0) chunk_flags |= MIDI_SYSEX_START;
+			else if(p[k] == 0xF7) chunk_flags |= MIDI_SYSEX_END;
+			else chunk[chunk_len++] = p[k];
+		}
+		if(chunk_flags & MIDI_SYSEX_END){
+			MIDI_SysExRxCallback(chunk_cable, chunk, chunk_len, chunk_flags);
+			chunk_len = 0;
+		}
+	}
+	if(chunk_len != 0) MIDI_SysExRxCallback(chunk_cable, chunk, chunk_len, chunk_flags);
+}
+
+/* То же для альтернативной настройки 1: буфер из слов UMP. MT1 и MT2
+   разбираются как пакеты MIDI 1.0, SysEx7 собирается в куски так же */
+void MIDI_ParseUMP(const uint32_t* words, uint32_t count){
+	MIDI_Message msg;
+	uint8_t chunk[SYSEX_CHUNK_MAX];
+	uint32_t chunk_len = 0;
+	uint8_t chunk_cable = 0, chunk_flags = 0;
+	for(uint32_t i = 0; i < count; ){
+		uint32_t w = words[i];
+		uint32_t n = ump_words[w >> 28];
+		uint8_t group = (w >> 24) & 0x0F;
+		uint8_t status = (w >> 16) & 0xFF;
+		if(i + n > count) break;                                                   // обрезанный UMP
+		switch(w >> 28){
+			case MIDI_MT_SYSTEM:
+			case MIDI_MT_MIDI1_VOICE:{
+				uint8_t p[4] = {(group << 4) | (status >> 4), status, (w >> 8) & 0xFF, w & 0xFF};
+				if((w >> 28) == MIDI_MT_SYSTEM) p[0] = (group << 4) | MIDI_CIN_SINGLE_BYTE;
+				if(MIDI_DecodePacket(p, &msg)) MIDI_RxCallback(&msg);
+				break;
+			}
+			case MIDI_MT_MIDI2_VOICE:
+				if(MIDI_DecodeVoice2(w, words[i + 1], &msg)) MIDI_RxCallback(&msg);
+				break;
+			case MIDI_MT_SYSEX7:{
+				uint8_t form = status >> 4;                                            // 0 целиком, 1 начало, 2 продолжение, 3 конец
+				uint8_t len = status & 0x0F;
+				uint8_t b[6] = {w >> 8, w, words[i + 1] >> 24, words[i + 1] >> 16, words[i + 1] >> 8, words[i + 1]};
+				if(len > 6) len = 6;
+				if(chunk_len != 0 && (chunk_cable != group || chunk_len + len > SYSEX_CHUNK_MAX)){
+					MIDI_SysExRxCallback(chunk_cable, chunk, chunk_len, chunk_flags);
+					chunk_len = 0;
+				}
+				if(chunk_len == 0){
+					chunk_cable = group;
+					chunk_flags = 0;
+				}
+				if(form == 0 || form == 1) chunk_flags |= MIDI_SYSEX_START;
+				for(uint8_t k = 0; k < len; k++) chunk[chunk_len++] = b[k] & 0x7F;
+				if(form == 0 || form == 3){
+					MIDI_SysExRxCallback(chunk_cable, chunk, chunk_len, chunk_flags | MIDI_SYSEX_END);
+					chunk_len = 0;
+				}
+				break;
+			}
+			default:                                                                   // NOOP, JR Timestamp и прочие MT пропускаются
+				break;
+		}
+		i += n;
+	}
+	if(chunk_len != 0) MIDI_SysExRxCallback(chunk_cable, chunk, chunk_len, chunk_flags);
+}
+
+static uint32_t MIDI_SysEx_MemReader(uint32_t offset, uint8_t* dst, uint32_t max){
+	uint32_t n = sysex_tx.len - offset;
+	if(n > max) n = max;
+	for(uint32_t i = 0; i < n; i++) dst[i] = sysex_tx.data[offset + i];
+	return n;
+}
+
+/* Запуск передачи SysEx из памяти (flash или RAM), data без F0/F7.
+   Буфер должен жить до окончания передачи (MIDI_SysEx_TxBusy) */
+bool MIDI_SysEx_Send(uint8_t cable, const uint8_t* data, uint32_t len){
+	if(sysex_tx.busy) return false;
+	sysex_tx.data = data;
+	return MIDI_SysEx_SendStream(cable, len, MIDI_SysEx_MemReader);
+}
+
+bool MIDI_SysEx_SendStream(uint8_t cable, uint32_t len, MIDI_SysExReader reader){
+	if(sysex_tx.busy) return false;
+	sysex_tx.reader = reader;
+	sysex_tx.len = len;
+	sysex_tx.pos = 0;
+	sysex_tx.cable = cable & 0x0F;
+	__DMB();
+	sysex_tx.busy = true;                                                          // с этого момента состоянием владеет SOF
+	return true;
+}
+
+bool MIDI_SysEx_TxBusy(void){
+	return sysex_tx.busy;
+}
+
+/* Кабель занят передаваемым SysEx: его канальные сообщения ждут F7 */
+bool MIDI_SysEx_TxOwns(uint8_t cable){
+	return sysex_tx.busy && sysex_tx.cable == (cable & 0x0F);
+}
+
+/* Бросить недопереданный SysEx, например при смене протокола. Только из потребителя */
+void MIDI_SysEx_Abort(void){
+	sysex_tx.busy = false;
+}
+
+/* SysEx7 в UMP: по 6 байт данных в 64-битном MT3, без F0/F7. Источник,
+   отдавший меньше запрошенного, не готов: слово не собирается */
+static uint32_t MIDI_SysEx_EncodeUMP(uint32_t* words, uint32_t max){
+	uint32_t count = 0;
+	while(sysex_tx.busy && count + 2U <= max){
+		uint8_t b[6] = {0, 0, 0, 0, 0, 0};
+		uint32_t pos = sysex_tx.pos;
+		uint32_t n = (sysex_tx.len - pos > 6U) ? 6U : sysex_tx.len - pos;
+		bool last = (pos + n == sysex_tx.len);
+		uint8_t form = (pos == 0) ? (last ? 0 : 1) : (last ? 3 : 2);
+		if(n != 0 && sysex_tx.reader(pos, b, n) < n) break;                       // данных еще нет - этот же кусок на следующем SOF
+		words[count++] = MIDI_UMP(MIDI_MT_SYSEX7, sysex_tx.cable, (form << 4) | n, b[0], b[1]);
+		words[count++] = ((uint32_t)b[2] << 24) | ((uint32_t)b[3] << 16) | ((uint32_t)b[4] << 8) | b[5];
+		sysex_tx.pos = pos + n;
+		if(last) sysex_tx.busy = false;
+	}
+	return count;
+}
+
+/* Режет поток F0 данные F7 на пакеты CIN 0x4..0x7 (в UMP - на MT3), не больше max слов.
+   Вызывается только потребителем очередей (SOF) */
+uint32_t MIDI_SysEx_Encode(uint32_t* packets, uint32_t max){
+	uint32_t count = 0;
+	uint32_t total = sysex_tx.len + 2U;
+	if(!sysex_tx.busy) return 0;
+	if(midi_protocol == MIDI_PROTOCOL_2_0) return MIDI_SysEx_EncodeUMP(packets, max);
+	while(count < max && sysex_tx.pos < total){
+		uint8_t b[3] = {0, 0, 0};
+		uint32_t pos = sysex_tx.pos;
+		uint32_t n = (total - pos > 3U) ? 3U : total - pos;
+		uint32_t first = (pos == 0) ? 1U : pos;                                    // диапазон байт данных в этом пакете
+		uint32_t last = (pos + n == total) ? total - 1U : pos + n;
+		if(pos == 0) b[0] = 0xF0;
+		if(last > first && sysex_tx.reader(first - 1U, &b[first - pos], last - first) < last - first) break;  // повтор на следующем SOF
+		if(pos + n == total) b[n - 1U] = 0xF7;
+		packets[count++] = MIDI_PACKET((sysex_tx.cable << 4) | (pos + n == total ? MIDI_CIN_SYSEX_START + n : MIDI_CIN_SYSEX_START),
+		                               b[0], b[1], b[2]);
+		sysex_tx.pos = pos + n;
+	}
+	if(sysex_tx.pos >= total) sysex_tx.busy = false;
+	return count;
+}
+
+/* Вызывается из прерывания USB для каждого принятого сообщения */
+__weak void MIDI_RxCallback(const MIDI_Message* msg){
+	UNUSED(msg);
+}
+
+/* Вызывается из прерывания USB с очередным куском SysEx (без F0/F7) */
+__weak void MIDI_SysExRxCallback(uint8_t cable, const uint8_t* data, uint32_t len, uint8_t flags){
+	UNUSED(cable);
+	UNUSED(data);
+	UNUSED(len);
+	UNUSED(flags);
+}
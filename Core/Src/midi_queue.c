@@ -0,0 +1,69 @@
+#include "midi_queue.h"
+#include "stm32f4xx.h"
+
+MIDI_Queue midi_queue[MIDI_QUEUE_COUNT];
+
+bool MIDI_Queue_Push(MIDI_QueueId id, uint32_t packet, uint8_t tag){
+	return MIDI_Queue_PushN(id, &packet, 1, tag);
+}
+
+/* Кладет n слов целиком или ничего - потребитель никогда не увидит половину UMP */
+bool MIDI_Queue_PushN(MIDI_QueueId id, const uint32_t* words, uint32_t n, uint8_t tag){
+	MIDI_Queue* q = &midi_queue[id];
+	uint32_t head = q->head;
+	uint32_t used = head - q->tail;                                              // индексы свободно бегут, переполнение uint32 безопасно
+	if(used + n > MIDI_QUEUE_SIZE){
+		++q->drops;
+		return false;
+	}
+	for(uint32_t i = 0; i < n; i++){
+		q->buf[(head + i) & MIDI_QUEUE_MASK] = words[i];
+		q->tag[(head + i) & MIDI_QUEUE_MASK] = tag;
+	}
+	__DMB();                                                                     // данные должны быть в памяти раньше, чем новый head
+	q->head = head + n;
+	if(used + n > q->high_water) q->high_water = used + n;
+	return true;
+}
+
+bool MIDI_Queue_Pop(MIDI_QueueId id, uint32_t* packet){
+	MIDI_Queue* q = &midi_queue[id];
+	uint32_t tail = q->tail;
+	if(tail == q->head) return false;
+	__DMB();
+	*packet = q->buf[tail & MIDI_QUEUE_MASK];
+	q->tail = tail + 1U;
+	return true;
+}
+
+bool MIDI_Queue_Peek(MIDI_QueueId id, uint32_t* packet, uint8_t* tag){
+	MIDI_Queue* q = &midi_queue[id];
+	uint32_t tail = q->tail;
+	if(tail == q->head) return false;
+	__DMB();
+	*packet = q->buf[tail & MIDI_QUEUE_MASK];
+	*tag = q->tag[tail & MIDI_QUEUE_MASK];
+	return true;
+}
+
+/* Выбросить все, что лежит в очереди. Только со стороны потребителя */
+void MIDI_Queue_Flush(MIDI_QueueId id){
+	midi_queue[id].tail = midi_queue[id].head;
+}
+
+uint32_t MIDI_Queue_Count(MIDI_QueueId id){
+	return midi_queue[id].head - midi_queue[id].tail;
+}
+
+uint32_t MIDI_Queue_Drops(MIDI_QueueId id){
+	return midi_queue[id].drops;
+}
+
+uint32_t MIDI_Queue_HighWater(MIDI_QueueId id){
+	return midi_queue[id].high_water;
+}
+
+void MIDI_Queue_ResetStats(MIDI_QueueId id){
+	midi_queue[id].drops = 0;
+	midi_queue[id].high_water = 0;
+}
@@ -0,0 +1,110 @@
+#include "pads.h"
+#include "hall.h"
+#include "midi_message.h"
+
+#if PADS_COUNT
+
+#if PADS_COUNT > 32
+#error "PADS_COUNT does not fit the pad bitmaps"
+#endif
+#if PADS_FIRST < HALL_KEYS || PADS_FIRST + PADS_COUNT > ANALOG_POTS
+#error "PADS_FIRST..PADS_FIRST + PADS_COUNT must be free analog inputs"
+#endif
+#if ANALOG_REFRESH_HZ < 5000U
+#error "Piezo pads need ANALOG_REFRESH_HZ of 5 kHz or more, see ANALOG_PADS"
+#endif
+#if PADS_SCAN_US + 1000000U / ANALOG_REFRESH_HZ + 1000U >= 2000U
+#error "PADS_SCAN_US leaves no room for the 2 ms hit latency"
+#endif
+
+static struct{
+	q15_t rest;                                                                    // отсчет в покое
+	uint16_t peak;                                                                 // пик текущего окна
+	uint16_t level;                                                                // пик для соседей, затухает
+	uint8_t scan;                                                                  // кругов до конца окна, 0 - окна нет
+	uint16_t mask;                                                                 // кругов до конца маски повтора
+}pad[PADS_COUNT];
+
+static uint32_t pads_neighbours[PADS_COUNT];
+static uint32_t pads_sounding;                                                   // пэды с Note On, Note Off в конце маски
+
+void Pads_init(const q15_t* raw){
+	for(uint8_t k = 0; k < PADS_COUNT; k++){
+		pad[k].rest = raw[ANALOG_INDEX(PADS_FIRST + k)];
+		pad[k].peak = 0;
+		pad[k].level = 0;
+		pad[k].scan = 0;
+		pad[k].mask = 0;
+		pads_neighbours[k] = ((1UL << k) >> 1) | (((1UL << k) << 1) & ((1UL << PADS_COUNT) - 1U));
+	}
+	pads_sounding = 0;
+}
+
+void Pads_SetNeighbours(uint8_t k, uint32_t mask){
+	if(k >= PADS_COUNT) return;
+	pads_neighbours[k] = mask & ~(1UL << k);
+}
+
+/* Наводка: хоть у одного соседа пик (текущий или недавний) громче
+   настолько, что этот удар мог прийти от него через корпус */
+static uint8_t Pads_Crosstalk(uint8_t k){
+	uint32_t n = pads_neighbours[k];
+	while(n){
+		uint8_t i = 31U - __CLZ(n);
+		n &= ~(1UL << i);
+		if((uint32_t)pad[k].peak * 100U < (uint32_t)pad[i].level * PADS_XTALK_PERCENT) return 1;
+	}
+	return 0;
+}
+
+static void Pads_Hit(uint8_t k){
+	int32_t v = ((int32_t)pad[k].peak - PADS_THRESHOLD) * 127 / (PADS_PEAK_MAX - PADS_THRESHOLD) + 1;
+	if(v > 127) v = 127;
+	if(pads_sounding & (1UL << k)) MIDI_SendNoteOff(MIDI_QUEUE_ANALOG, PADS_CHANNEL, PADS_NOTE_FIRST + k, 0);
+	pads_sounding |= 1UL << k;
+	MIDI_SendNoteOn(MIDI_QUEUE_ANALOG, PADS_CHANNEL, PADS_NOTE_FIRST + k, MIDI_Upscale(v, 7, 16));
+}
+
+/* Круг мультиплексоров, PendSV. Окна, закрытые на этом
+   круге, разбираются после обхода всех пэдов: одновременный удар на
+   громком соседе уже виден в его level */
+void Pads_Process(const q15_t* raw){
+	uint32_t done = 0;
+	for(uint8_t k = 0; k < PADS_COUNT; k++){
+		int32_t x = raw[ANALOG_INDEX(PADS_FIRST + k)];
+		int32_t v = x - pad[k].rest;
+		pad[k].level -= pad[k].level >> PADS_XTALK_SHIFT;
+		if(pad[k].mask){
+			if(--pad[k].mask == 0 && (pads_sounding & (1UL << k))){
+				pads_sounding &= ~(1UL << k);
+				MIDI_SendNoteOff(MIDI_QUEUE_ANALOG, PADS_CHANNEL, PADS_NOTE_FIRST + k, 0);
+			}
+			continue;
+		}
+		if(!pad[k].scan){
+			if(v < PADS_THRESHOLD){
+				pad[k].rest += (x - pad[k].rest) >> 6;                                 // покой медленно следует за дрейфом смещения
+				continue;
+			}
+			pad[k].scan = PADS_SCAN_CYCLES;
+			pad[k].peak = 0;
+		}
+		if(v > pad[k].peak) pad[k].peak = v;
+		if(pad[k].level < pad[k].peak) pad[k].level = pad[k].peak;
+		if(--pad[k].scan == 0) done |= 1UL << k;
+	}
+	while(done){
+		uint8_t k = 31U - __CLZ(done);
+		done &= ~(1UL << k);
+		pad[k].mask = PADS_MASK_CYCLES;                                             // отброшенный удар тоже звенит
+		if(!Pads_Crosstalk(k)) Pads_Hit(k);
+	}
+}
+
+#else
+
+void Pads_init(const q15_t* raw){}
+void Pads_Process(const q15_t* raw){}
+void Pads_SetNeighbours(uint8_t pad, uint32_t mask){}
+
+#endif
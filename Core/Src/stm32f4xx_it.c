@@ -22,6 +22,9 @@
 #include "stm32f4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "keys.h"
+#include "encoder.h"
+#include "analog.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -55,9 +58,9 @@
 /* USER CODE END 0 */
 
 /* External variables --------------------------------------------------------*/
+extern ADC_HandleTypeDef hadc1;
 extern PCD_HandleTypeDef hpcd_USB_OTG_FS;
 /* USER CODE BEGIN EV */
-extern uint8_t x;
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -170,7 +173,7 @@ void DebugMon_Handler(void)
 void PendSV_Handler(void)
 {
   /* USER CODE BEGIN PendSV_IRQn 0 */
-
+	Analog_Cycle();
   /* USER CODE END PendSV_IRQn 0 */
   /* USER CODE BEGIN PendSV_IRQn 1 */
 
@@ -212,165 +215,36 @@ void OTG_FS_IRQHandler(void)
   /* USER CODE END OTG_FS_IRQn 1 */
 }
 /**
-  * @brief This function handles EXTI line0 interrupt.
-  */
-void EXTI0_IRQHandler(void)
-{
-  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_0);
-}
-void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
-{
-  if(GPIO_Pin == GPIO_PIN_0)
-  {
-		++x;
-		send_note_message(0x3A);
-		delay_ms(100);
-    // Обработка прерывания для PA0
-    // Ваш код здесь
-  }
-	else if(GPIO_Pin == GPIO_PIN_1)
-  {
-		send_note_message(0x3B);
-		delay_ms(100);
-    // Обработка прерывания для PA0
-    // Ваш код здесь
-  }
-	else if(GPIO_Pin == GPIO_PIN_2)
-  {
-		send_note_message(0x3C);
-		delay_ms(100);
-    // Обработка прерывания для PA0
-    // Ваш код здесь
-  }
-	else if(GPIO_Pin == GPIO_PIN_3)
-  {
-		send_note_message(0x3D);
-		delay_ms(100);
-    // Обработка прерывания для PA0
-    // Ваш код здесь
-  }
-	else if(GPIO_Pin == GPIO_PIN_4)
-  {
-		send_note_message(0x3E);
-		delay_ms(100);
-    // Обработка прерывания для PA0
-    // Ваш код здесь
-  }
-	else if(GPIO_Pin == GPIO_PIN_5)
-  {
-		send_note_message(0x3F);
-		delay_ms(100);
-    // Обработка прерывания для PA0
-    // Ваш код здесь
-  }
-	else if(GPIO_Pin == GPIO_PIN_8)
-  {
-		send_note_message(0x40);
-		delay_ms(100);
-    // Обработка прерывания для PA0
-    // Ваш код здесь
-  }
-	else if(GPIO_Pin == GPIO_PIN_9)
-  {
-		send_note_message(0x41);
-		delay_ms(100);
-    // Обработка прерывания для PA0
-    // Ваш код здесь
-  }
-	else if(GPIO_Pin == GPIO_PIN_10)
-  {
-		send_note_message(0x42);
-		delay_ms(100);
-    // Обработка прерывания для PA0
-    // Ваш код здесь
-  }
-}
-
-/**
-  * @brief This function handles EXTI line1 interrupt.
+  * @brief This function handles TIM1 update interrupt and TIM10 global interrupt.
   */
-void EXTI1_IRQHandler(void)
+void TIM1_UP_TIM10_IRQHandler(void)
 {
-  /* USER CODE BEGIN EXTI1_IRQn 0 */
-
-  /* USER CODE END EXTI1_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_1);
-  /* USER CODE BEGIN EXTI1_IRQn 1 */
+  /* USER CODE BEGIN TIM1_UP_TIM10_IRQn 0 */
+	if(TIM10->SR & TIM_SR_UIF){
+		TIM10->SR &= ~TIM_SR_UIF;
+		Keys_Tick();
+		Encoder_Tick();
+	}
+  /* USER CODE END TIM1_UP_TIM10_IRQn 0 */
+  /* USER CODE BEGIN TIM1_UP_TIM10_IRQn 1 */
 
-  /* USER CODE END EXTI1_IRQn 1 */
+  /* USER CODE END TIM1_UP_TIM10_IRQn 1 */
 }
 
 /**
-  * @brief This function handles EXTI line2 interrupt.
+  * @brief This function handles ADC1 global interrupt.
   */
-void EXTI2_IRQHandler(void)
+void ADC_IRQHandler(void)
 {
-  /* USER CODE BEGIN EXTI2_IRQn 0 */
-
-  /* USER CODE END EXTI2_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_2);
-  /* USER CODE BEGIN EXTI2_IRQn 1 */
+  /* USER CODE BEGIN ADC_IRQn 0 */
+	Analog_Sequence();
+  /* USER CODE END ADC_IRQn 0 */
+  HAL_ADC_IRQHandler(&hadc1);
+  /* USER CODE BEGIN ADC_IRQn 1 */
 
-  /* USER CODE END EXTI2_IRQn 1 */
+  /* USER CODE END ADC_IRQn 1 */
 }
 
-/**
-  * @brief This function handles EXTI line3 interrupt.
-  */
-void EXTI3_IRQHandler(void)
-{
-  /* USER CODE BEGIN EXTI3_IRQn 0 */
-
-  /* USER CODE END EXTI3_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_3);
-  /* USER CODE BEGIN EXTI3_IRQn 1 */
-
-  /* USER CODE END EXTI3_IRQn 1 */
-}
-
-/**
-  * @brief This function handles EXTI line4 interrupt.
-  */
-void EXTI4_IRQHandler(void)
-{
-  /* USER CODE BEGIN EXTI4_IRQn 0 */
-
-  /* USER CODE END EXTI4_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_4);
-  /* USER CODE BEGIN EXTI4_IRQn 1 */
-
-  /* USER CODE END EXTI4_IRQn 1 */
-}
-
-/**
-  * @brief This function handles EXTI line[9:5] interrupts.
-  */
-void EXTI9_5_IRQHandler(void)
-{
-  /* USER CODE BEGIN EXTI9_5_IRQn 0 */
-
-  /* USER CODE END EXTI9_5_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_5);
-  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_8);
-  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_9);
-  /* USER CODE BEGIN EXTI9_5_IRQn 1 */
-
-  /* USER CODE END EXTI9_5_IRQn 1 */
-}
-
-/**
-  * @brief This function handles EXTI line[15:10] interrupts.
-  */
-void EXTI15_10_IRQHandler(void)
-{
-  /* USER CODE BEGIN EXTI15_10_IRQn 0 */
-
-  /* USER CODE END EXTI15_10_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_10);
-  /* USER CODE BEGIN EXTI15_10_IRQn 1 */
-
-  /* USER CODE END EXTI15_10_IRQn 1 */
-}
 /* USER CODE BEGIN 1 */
 
 /* USER CODE END 1 */
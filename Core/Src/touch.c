@@ -0,0 +1,144 @@
+#include "touch.h"
+#include "stm32f4xx_hal.h"
+#include "hall.h"
+#include "pads.h"
+#include "midi_message.h"
+
+#if TOUCH_COUNT
+
+#if ANALOG_MUX_WAYS < 2U || TOUCH_WAY_FIRST + TOUCH_COUNT > ANALOG_MUX_WAYS
+#error "Touch electrodes must be mux 1 pins TOUCH_WAY_FIRST..ANALOG_MUX_WAYS - 1"
+#endif
+#if TOUCH_POT_FIRST < HALL_KEYS || (PADS_COUNT && TOUCH_POT_FIRST < PADS_FIRST + PADS_COUNT && PADS_FIRST < TOUCH_POT_FIRST + TOUCH_COUNT)
+#error "Touch electrodes overlap the Hall keys or the pads"
+#endif
+
+static struct{
+	int32_t base;                                                                  // база в тиках << 4
+	int32_t filt;                                                                  // сглаженное время заряда в тиках << 4
+	uint8_t drift;
+	uint8_t touched;
+	uint8_t primed;                                                                // база взята с настоящего отсчета
+	uint8_t lost;                                                                  // был таймаут, filt устарел
+}touch[TOUCH_COUNT];
+
+static volatile uint16_t touch_ticks[TOUCH_COUNT];                               // последнее измерение
+static uint8_t touch_pending;                                                    // электрод разряжается, ждет Touch_Charge
+static uint8_t touch_sensor;                                                     // электрод текущего адреса
+static uint16_t touch_start;                                                     // CNT в момент отпускания
+
+/* TIM3 считает свободно на частоте ядра, CH1 захватывает фронт TI1 (PA6)
+   без фильтра и делителя. Вывод остается аналоговым, пока адрес не электрод */
+void Touch_init(void){
+	RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;
+	TIM3->PSC = 0;
+	TIM3->ARR = 0xFFFF;
+	TIM3->CCMR1 = (TIM3->CCMR1 & ~(TIM_CCMR1_CC1S | TIM_CCMR1_IC1F | TIM_CCMR1_IC1PSC)) | TIM_CCMR1_CC1S_0;
+	TIM3->CCER = (TIM3->CCER & ~(TIM_CCER_CC1P | TIM_CCER_CC1NP)) | TIM_CCER_CC1E;
+	TIM3->CR1 |= TIM_CR1_CEN;
+	GPIOA->AFR[0] = (GPIOA->AFR[0] & ~GPIO_AFRL_AFSEL6) | (2U << GPIO_AFRL_AFSEL6_Pos);  // AF2, действует только в режиме AF
+	GPIOA->BSRR = (uint32_t)GPIO_PIN_6 << 16;                                     // ODR = 0 для разряда
+	for(uint8_t k = 0; k < TOUCH_COUNT; k++){
+		touch_ticks[k] = TOUCH_TIMEOUT;
+		touch[k].primed = 0;
+	}
+	touch_pending = 0;
+}
+
+/* Прерывание JEOC АЦП, мультиплексоры только что переключены с addr на next.
+   Захват прошлого электрода уже в CCR1; следующий электрод начинает
+   разряжаться, пока разбирается последовательность */
+void Touch_Discharge(uint8_t addr, uint8_t next){
+	uint32_t moder = GPIOA->MODER & ~GPIO_MODER_MODER6;
+	if(addr >= TOUCH_WAY_FIRST && addr < TOUCH_WAY_FIRST + TOUCH_COUNT)
+		touch_ticks[addr - TOUCH_WAY_FIRST] = (TIM3->SR & TIM_SR_CC1IF) ? (uint16_t)(TIM3->CCR1 - touch_start) : TOUCH_TIMEOUT;
+	if(next >= TOUCH_WAY_FIRST && next < TOUCH_WAY_FIRST + TOUCH_COUNT){
+		GPIOA->MODER = moder | GPIO_MODER_MODER6_0;                                 // выход 0 через ключ мультиплексора
+		GPIOA->PUPDR = (GPIOA->PUPDR & ~GPIO_PUPDR_PUPDR6) | GPIO_PUPDR_PUPDR6_0;
+		touch_sensor = next - TOUCH_WAY_FIRST;
+		touch_pending = 1;
+	}else{
+		GPIOA->PUPDR &= ~GPIO_PUPDR_PUPDR6;
+		GPIOA->MODER = moder | GPIO_MODER_MODER6;                                   // снова IN6
+	}
+}
+
+/* Отпускает электрод на подтяжку. Переключение и чтение CNT подряд без
+   прерываний: смещение постоянное, его съедает база */
+void Touch_Charge(void){
+	uint32_t moder;
+	if(!touch_pending) return;
+	touch_pending = 0;
+	moder = (GPIOA->MODER & ~GPIO_MODER_MODER6) | GPIO_MODER_MODER6_1;
+	TIM3->SR = ~(uint32_t)TIM_SR_CC1IF;
+	__disable_irq();
+	GPIOA->MODER = moder;
+	touch_start = TIM3->CNT;
+	__enable_irq();
+}
+
+/* Полный круг мультиплексоров: сглаживание, база, события касания.
+   Ноты идут по кабелю аналоговых контроллеров, как у клавиш Холла.
+   Таймаут - не отсчет: фильтр и база его не видят, сенсор отпускается,
+   а первый отсчет после него заново задает фильтр */
+void Touch_Process(void){
+	for(uint8_t k = 0; k < TOUCH_COUNT; k++){
+		uint16_t ticks = touch_ticks[k];
+		int32_t x = (int32_t)ticks << 4;
+		int32_t d;
+		if(ticks == TOUCH_TIMEOUT){
+			touch[k].lost = 1;
+			if(touch[k].touched){
+				touch[k].touched = 0;
+				MIDI_SendNoteOff(MIDI_QUEUE_ANALOG, TOUCH_CHANNEL, TOUCH_NOTE_FIRST + k, 0);
+			}
+			continue;
+		}
+		if(!touch[k].primed){
+			touch[k].base = touch[k].filt = x;
+			touch[k].drift = 0;
+			touch[k].touched = 0;
+			touch[k].primed = 1;
+			touch[k].lost = 0;
+			continue;
+		}
+		if(touch[k].lost){                                                           // после таймаута фильтр начинает с отсчета, база прежняя
+			touch[k].filt = x;
+			touch[k].lost = 0;
+		}
+		touch[k].filt += (x - touch[k].filt) >> 2;
+		d = touch[k].filt - touch[k].base;
+		if(touch[k].touched){
+			if(d >= (int32_t)TOUCH_OFF << 4) continue;
+			touch[k].touched = 0;
+			MIDI_SendNoteOff(MIDI_QUEUE_ANALOG, TOUCH_CHANNEL, TOUCH_NOTE_FIRST + k, 0);
+		}else if(d >= (int32_t)TOUCH_ON << 4){
+			touch[k].touched = 1;
+			MIDI_SendNoteOn(MIDI_QUEUE_ANALOG, TOUCH_CHANNEL, TOUCH_NOTE_FIRST + k, 0xFFFF);
+		}else if(d < 0){
+			touch[k].base = touch[k].filt;
+		}else if(++touch[k].drift >= TOUCH_DRIFT_CYCLES){
+			touch[k].drift = 0;
+			++touch[k].base;
+		}
+	}
+}
+
+uint8_t Touch_Get(uint8_t sensor){
+	return (sensor < TOUCH_COUNT) ? touch[sensor].touched : 0;
+}
+
+uint16_t Touch_GetTicks(uint8_t sensor){
+	return (sensor < TOUCH_COUNT) ? touch_ticks[sensor] : 0;
+}
+
+#else
+
+void Touch_init(void){}
+void Touch_Discharge(uint8_t addr, uint8_t next){}
+void Touch_Charge(void){}
+void Touch_Process(void){}
+uint8_t Touch_Get(uint8_t sensor){ return 0; }
+uint16_t Touch_GetTicks(uint8_t sensor){ return 0; }
+
+#endif
@@ -0,0 +1,149 @@
+/**
+  ******************************************************************************
+  * @file    usbd_midi.h
+  * @brief   Header file for the usbd_midi.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2023 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_MIDI_H
+#define __USB_MIDI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_ioreq.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USBD_MIDI
+  * @brief This file is the Header file for usbd_midi.c
+  * @{
+  */
+
+
+/** @defgroup USBD_MIDI_Exported_Defines
+  * @{
+  */
+#ifndef MIDI_EPIN_ADDR
+#define MIDI_EPIN_ADDR                             0x81U
+#endif /* MIDI_EPIN_ADDR */
+
+#ifndef MIDI_EPOUT_ADDR
+#define MIDI_EPOUT_ADDR                            0x01U
+#endif /* MIDI_EPOUT_ADDR */
+
+#define MIDI_DATA_FS_MAX_PACKET_SIZE               0x40U  /* Endpoint IN & OUT Packet size */
+#define MIDI_EPIN_SIZE                             MIDI_DATA_FS_MAX_PACKET_SIZE
+#define MIDI_EPOUT_SIZE                            MIDI_DATA_FS_MAX_PACKET_SIZE
+
+#define MIDI_EVENT_PACKET_SIZE                     4U     /* USB-MIDI 1.0 event packet */
+#define MIDI_EVENTS_PER_TRANSFER                   (MIDI_EPIN_SIZE / MIDI_EVENT_PACKET_SIZE)
+
+#define MIDI_MS_INTERFACE                          0x01U  /* MIDI Streaming interface number */
+#define MIDI_ALT_MIDI_1_0                          0x00U  /* USB-MIDI 1.0 event packets */
+#define MIDI_ALT_MIDI_2_0                          0x01U  /* USB-MIDI 2.0 Universal MIDI Packets */
+
+#define MIDI_CS_GR_TRM_BLOCK                       0x26U  /* Group Terminal Block descriptor type */
+
+#ifndef MIDI_CABLES
+#define MIDI_CABLES                                1U     /* Virtual cables (MIDI 1.0) / groups (UMP) */
+#endif /* MIDI_CABLES */
+
+#if (MIDI_CABLES < 1U) || (MIDI_CABLES > 16U)
+#error "MIDI_CABLES must be 1..16"
+#endif
+
+/* Jack IDs of a cable: 1 embedded IN, 2 external IN, 3 embedded OUT, 4 external OUT */
+#define MIDI_JACK_ID(cable, n)                     ((uint8_t)(((cable) * 4U) + (n)))
+
+#define USB_MIDI_CFG_HEAD_DESC_SIZ                 43U
+#define USB_MIDI_JACKS_DESC_SIZ                    30U    /* Per cable */
+#define USB_MIDI_MS_DESC_SIZ                       (7U + (USB_MIDI_JACKS_DESC_SIZ * MIDI_CABLES) + (2U * (13U + MIDI_CABLES)))
+#define USB_MIDI_ALT2_DESC_SIZ                     (16U + (2U * (11U + MIDI_CABLES)))
+#define USB_MIDI_CONFIG_DESC_SIZ                   (36U + USB_MIDI_MS_DESC_SIZ + USB_MIDI_ALT2_DESC_SIZ)
+#define USB_MIDI_GR_TRM_BLOCK_DESC_SIZ             (5U + (13U * MIDI_CABLES))
+/**
+  * @}
+  */
+
+
+/** @defgroup USBD_MIDI_Exported_TypesDefinitions
+  * @{
+  */
+typedef enum
+{
+  MIDI_IDLE = 0,
+  MIDI_BUSY,
+} MIDI_StateTypeDef;
+
+typedef struct _USBD_MIDI_Itf
+{
+  int8_t (* Init)(void);
+  int8_t (* DeInit)(void);
+  int8_t (* Receive)(uint8_t *Buf, uint32_t Len);
+  int8_t (* TransmitCplt)(uint8_t *Buf, uint32_t Len);
+  int8_t (* SOF)(void);
+  int8_t (* SetAlt)(uint8_t AltSetting);
+} USBD_MIDI_ItfTypeDef;
+
+typedef struct
+{
+  uint32_t RxBuffer[MIDI_EPOUT_SIZE / 4U];  /* Force 32-bit alignment */
+  uint8_t  *TxBuffer;
+  uint32_t TxLength;
+  uint32_t RxLength;
+  uint32_t AltSetting;
+  __IO MIDI_StateTypeDef TxState;
+} USBD_MIDI_HandleTypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup USBD_MIDI_Exported_Variables
+  * @{
+  */
+
+extern USBD_ClassTypeDef USBD_MIDI;
+#define USBD_MIDI_CLASS &USBD_MIDI
+/**
+  * @}
+  */
+
+/** @defgroup USBD_MIDI_Exported_Functions
+  * @{
+  */
+uint8_t USBD_MIDI_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_MIDI_ItfTypeDef *fops);
+uint8_t USBD_MIDI_Transmit(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uint32_t length);
+uint8_t USBD_MIDI_ReceivePacket(USBD_HandleTypeDef *pdev);
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_MIDI_H */
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
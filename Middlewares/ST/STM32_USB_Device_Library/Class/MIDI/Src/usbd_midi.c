@@ -0,0 +1,866 @@
+/**
+  ******************************************************************************
+  * @file    usbd_midi.c
+  * @brief   This file provides the USB-MIDI 1.0 / 2.0 core functions.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2023 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                MIDI Class  Description
+  *          ===================================================================
+  *           This module manages the MIDI class following the "Universal Serial
+  *           Bus Device Class Definition for MIDI Devices, Release 1.0".
+  *           This driver implements the following aspects of the specification:
+  *             - Audio Control interface without endpoints
+  *             - MIDI Streaming interface with one bulk IN and one bulk OUT
+  *               endpoint of 64 bytes, i.e. up to 16 event packets per transfer
+  *             - Start Of Frame notification to the interface for frame
+  *               synchronous transmission
+  *             - One embedded/external MIDI IN and OUT jack pair per
+  *               virtual cable, MIDI_CABLES cables, descriptor generated at
+  *               run time to match
+  *             - MIDI Streaming alternate setting 1 following "USB Device
+  *               Class Definition for MIDI Devices, Release 2.0": the same
+  *               bulk endpoints carry Universal MIDI Packets, with one
+  *               bidirectional Group Terminal Block per cable returned on
+  *               request.
+  *               Alternate setting 0 stays the MIDI 1.0 fallback.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_midi.h"
+#include "usbd_ctlreq.h"
+#include "midi_message.h"
+
+/* bMIDIProtocol of the Group Terminal Blocks: the UMP stream puts a JR
+   Timestamp in front of every note when MIDI_UMP_JR_TIMESTAMPS is set */
+#if MIDI_UMP_JR_TIMESTAMPS
+#define MIDI_BLOCK_PROTOCOL                        0x12U  /* MIDI 2.0 with JR Timestamps */
+#else
+#define MIDI_BLOCK_PROTOCOL                        0x11U  /* MIDI 2.0 */
+#endif
+
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup USBD_MIDI
+  * @brief usbd core module
+  * @{
+  */
+
+/** @defgroup USBD_MIDI_Private_FunctionPrototypes
+  * @{
+  */
+
+static uint8_t USBD_MIDI_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_MIDI_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_MIDI_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t USBD_MIDI_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_MIDI_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_MIDI_SOF(USBD_HandleTypeDef *pdev);
+static void USBD_MIDI_SetAlt(USBD_HandleTypeDef *pdev, uint8_t alt);
+static void USBD_MIDI_BuildDesc(void);
+static uint8_t *USBD_MIDI_GetFSCfgDesc(uint16_t *length);
+static uint8_t *USBD_MIDI_GetHSCfgDesc(uint16_t *length);
+static uint8_t *USBD_MIDI_GetOtherSpeedCfgDesc(uint16_t *length);
+static uint8_t *USBD_MIDI_GetDeviceQualifierDesc(uint16_t *length);
+/**
+  * @}
+  */
+
+/** @defgroup USBD_MIDI_Private_Variables
+  * @{
+  */
+
+USBD_ClassTypeDef USBD_MIDI =
+{
+  USBD_MIDI_Init,
+  USBD_MIDI_DeInit,
+  USBD_MIDI_Setup,
+  NULL,              /* EP0_TxSent */
+  NULL,              /* EP0_RxReady */
+  USBD_MIDI_DataIn,  /* DataIn */
+  USBD_MIDI_DataOut, /* DataOut */
+  USBD_MIDI_SOF,     /* SOF */
+  NULL,
+  NULL,
+  USBD_MIDI_GetHSCfgDesc,
+  USBD_MIDI_GetFSCfgDesc,
+  USBD_MIDI_GetOtherSpeedCfgDesc,
+  USBD_MIDI_GetDeviceQualifierDesc,
+};
+
+/* Fixed head of the configuration descriptor, up to the MIDI 1.0 MS header.
+   The jacks, endpoints and the MIDI 2.0 alternate setting that follow depend
+   on MIDI_CABLES and are appended by USBD_MIDI_BuildDesc() */
+static const uint8_t USBD_MIDI_CfgDescHead[USB_MIDI_CFG_HEAD_DESC_SIZ] =
+{/* MIDI Adapter Configuration Descriptor: 9Bytes */
+		/* Reference: https://www.usb.org/sites/default/files/midi10.pdf Page: 37,38 */
+		  0x09,		// Length of the Descriptor (1Byte)
+		  0x02,		// Descriptor Type: Configuration (1Byte)
+		  LOBYTE(USB_MIDI_CONFIG_DESC_SIZ),	// Total Length of the config. block including this descriptor (2bytes Low-byte first)
+		  HIBYTE(USB_MIDI_CONFIG_DESC_SIZ),	// Total Length high-byte, continuing from above
+		  0x02,		// Number of Interfaces: 2 interfaces: Standard AC and Standard MIDI-streaming (1Byte)
+		  0x01,		// Configuration Value: ID of this configuration is 1 (1Byte)
+		  0x00,		// iConfiguration: Unused (1Byte)
+		  0x80,		// bmAttributes:   BUS Powered and not Battery/Self powered and no remote wake-up (1Byte)
+		  0x32,		// MaxPower = 100 mA, in steps of 2mA (1Byte)
+
+
+		  /* MIDI Adapter Standard Audio Control (AC) Interface Descriptor: 9Bytes */
+		  /* Reference: https://www.usb.org/sites/default/files/midi10.pdf Page: 38 */
+		  0x09,		// Length of the Descriptor (1Byte)
+		  0x04,		// Descriptor Type: Interface (1Byte)
+		  0x00,		// Index of this interface (1Byte)
+		  0x00,		// Alternate Setting: Index of this Setting (1Byte)
+		  0x00,		// Number of End-points (1Byte)
+		  0x01,		// Interface Class: Audio (1Byte)
+		  0x01,		// Interface Sub-Class: Audio Control (1Byte)
+		  0x00,		// Interface Protocol: Unused (1Byte)
+		  0x00,		// iInterface: Unused (1Byte)
+
+
+		  /* MIDI Adapter Class-specific AC Interface Descriptor: 9Bytes */
+		  /* Reference: https://www.usb.org/sites/default/files/midi10.pdf Page: 39 */
+		  0x09,		// Length of the Descriptor (1Byte)
+		  0x24,		// Descriptor Type: Class specific interface (1Byte)
+		  0x01,		// Descriptor Sub-type: Class Specific Interface Header (1Byte)
+		  0x00,		// Class Specification Revision No.: 1.00 (2Bytes Low-byte first)
+		  0x01,		// Class Specification revision No.: High-byte, continuing from above
+		  0x09,		// Total Length of class-specific descriptor: 9-bytes (2Bytes Low-byte first)
+		  0x00,		// Total Length of class-specific descriptor: High-byte, Continuing from above
+		  0x01,     // Number of streaming interfaces: 1 (1Byte)
+		  0x01,		// baInterfaceNr: MIDI-Streaming interface 1 belongs to this AudioControl interface. (1Byte)
+
+
+		  /* MIDI Adapter Standard MIDI Streaming (MS) Interface Descriptor: 9Bytes  */
+		  /* Reference: https://www.usb.org/sites/default/files/midi10.pdf Page: 39 */
+		  0x09,		// Length of the Descriptor (1Byte)
+		  0x04,		// Descriptor Type: Interface (1Byte)
+		  0x01,		// Index of this interface (1Byte)
+		  0x00,		// Alternate Setting: Index of this Setting (1Byte)
+		  0x02,		// Number of End-points (1Byte)
+		  0x01,		// Interface Class: Audio (1Byte)
+		  0x03,		// Interface Sub-Class: MIDI-Streaming (1Byte)
+		  0x00,		// Interface Protocol: Unused (1Byte)
+		  0x00,		// iInterface: Unused (1Byte)
+
+
+		  /*  MIDI Adapter Class-specific MS Interface Descriptor: 7Bytes */
+		  /* Reference: https://www.usb.org/sites/default/files/midi10.pdf Page: 40 */
+		  0x07,		// Length of the Descriptor (1Byte)
+		  0x24,		// Descriptor Type: Class specific interface (1Byte)
+		  0x01,		// Descriptor Sub-type: Class Specific Interface Header (1Byte)
+		  0x00,		// Class Specification Revision No.: 1.00 (2Bytes Low-byte first)
+		  0x01,		// Class Specification revision No.: High-byte, continuing from above
+		  LOBYTE(USB_MIDI_MS_DESC_SIZ),	// Total length of class specific descriptors incl. jacks and endpoints (2bytes Low-byte first)
+		  HIBYTE(USB_MIDI_MS_DESC_SIZ)	// Total Length high-byte, continuing from above
+};
+
+/* Generated configuration descriptor */
+__ALIGN_BEGIN static uint8_t USBD_MIDI_CfgDesc[USB_MIDI_CONFIG_DESC_SIZ] __ALIGN_END;
+
+/* USB MIDI 2.0 Group Terminal Block descriptors, one block per cable, read by
+   the host with a GET_DESCRIPTOR request addressed to the MIDI Streaming
+   interface. Generated together with USBD_MIDI_CfgDesc */
+__ALIGN_BEGIN static uint8_t USBD_MIDI_GrpTrmBlkDesc[USB_MIDI_GR_TRM_BLOCK_DESC_SIZ] __ALIGN_END;
+
+/* USB Standard Device Descriptor */
+__ALIGN_BEGIN static uint8_t USBD_MIDI_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
+{
+  USB_LEN_DEV_QUALIFIER_DESC,
+  USB_DESC_TYPE_DEVICE_QUALIFIER,
+  0x00,
+  0x02,
+  0x00,
+  0x00,
+  0x00,
+  0x40,
+  0x01,
+  0x00,
+};
+
+static uint8_t USBD_MIDI_DescReady = 0U;
+
+static uint8_t MIDIInEpAdd  = MIDI_EPIN_ADDR;
+static uint8_t MIDIOutEpAdd = MIDI_EPOUT_ADDR;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_MIDI_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_MIDI_PutDesc
+  *         Append one descriptor to the descriptor being generated
+  * @param  pdesc: write position
+  * @param  src: descriptor bytes
+  * @param  len: descriptor length
+  * @retval next write position
+  */
+static uint8_t *USBD_MIDI_PutDesc(uint8_t *pdesc, const uint8_t *src, uint32_t len)
+{
+  (void)USBD_memcpy(pdesc, src, len);
+  return pdesc + len;
+}
+
+/**
+  * @brief  USBD_MIDI_BuildDesc
+  *         Generate the configuration and Group Terminal Block descriptors
+  *         for MIDI_CABLES cables. Alternate setting 0 gets one embedded and
+  *         one external MIDI IN/OUT jack pair per cable, jack IDs 4n+1 to
+  *         4n+4 for cable n. Alternate setting 1 gets one Group Terminal
+  *         Block per cable, block n+1 spanning group n.
+  * @retval None
+  */
+static void USBD_MIDI_BuildDesc(void)
+{
+  uint8_t *pdesc = USBD_MIDI_CfgDesc;
+  uint8_t cable;
+
+  if (USBD_MIDI_DescReady != 0U)
+  {
+    return;
+  }
+
+  pdesc = USBD_MIDI_PutDesc(pdesc, USBD_MIDI_CfgDescHead, sizeof(USBD_MIDI_CfgDescHead));
+
+  for (cable = 0U; cable < MIDI_CABLES; cable++)
+  {
+    const uint8_t jacks[USB_MIDI_JACKS_DESC_SIZ] =
+    {
+      /* MIDI Adapter MIDI IN Jack Descriptor (Embedded): 6Bytes */
+      /* Reference: https://www.usb.org/sites/default/files/midi10.pdf Page: 40 */
+      0x06,                           // Length of the Descriptor (1Byte)
+      0x24,                           // Descriptor Type: Class specific interface (1Byte)
+      0x02,                           // Descriptor Sub-type: MIDI IN Jack (1Byte)
+      0x01,                           // Jack Type: Embedded (1Byte)
+      MIDI_JACK_ID(cable, 1U),        // Jack ID (1Byte)
+      0x00,                           // iJack: Unused (1Byte)
+
+      /* MIDI Adapter MIDI IN Jack Descriptor (External): 6Bytes */
+      0x06,                           // Length of the Descriptor (1Byte)
+      0x24,                           // Descriptor Type: Class specific interface (1Byte)
+      0x02,                           // Descriptor Sub-type: MIDI IN Jack (1Byte)
+      0x02,                           // Jack Type: External (1Byte)
+      MIDI_JACK_ID(cable, 2U),        // Jack ID (1Byte)
+      0x00,                           // iJack: Unused (1Byte)
+
+      /* MIDI Adapter MIDI OUT Jack Descriptor (Embedded): 9Bytes */
+      /* Reference: https://www.usb.org/sites/default/files/midi10.pdf Page: 41 */
+      0x09,                           // Length of the Descriptor (1Byte)
+      0x24,                           // Descriptor Type: Class specific interface (1Byte)
+      0x03,                           // Descriptor Sub-type: MIDI OUT Jack (1Byte)
+      0x01,                           // Jack Type: Embedded (1Byte)
+      MIDI_JACK_ID(cable, 3U),        // Jack ID (1Byte)
+      0x01,                           // Number of Input Pins for this jack: 1 (1Byte)
+      MIDI_JACK_ID(cable, 2U),        // Source ID: External MIDI IN Jack of this cable (1Byte)
+      0x01,                           // Source Pin (1Byte)
+      0x00,                           // iJack: Unused (1Byte)
+
+      /* MIDI Adapter MIDI OUT Jack Descriptor (External): 9Bytes */
+      0x09,                           // Length of the Descriptor (1Byte)
+      0x24,                           // Descriptor Type: Class specific interface (1Byte)
+      0x03,                           // Descriptor Sub-type: MIDI OUT Jack (1Byte)
+      0x02,                           // Jack Type: External (1Byte)
+      MIDI_JACK_ID(cable, 4U),        // Jack ID (1Byte)
+      0x01,                           // Number of Input Pins for this jack: 1 (1Byte)
+      MIDI_JACK_ID(cable, 1U),        // Source ID: Embedded MIDI IN Jack of this cable (1Byte)
+      0x01,                           // Source Pin (1Byte)
+      0x00                            // iJack: Unused (1Byte)
+    };
+    pdesc = USBD_MIDI_PutDesc(pdesc, jacks, sizeof(jacks));
+  }
+
+  {
+    /* MIDI Adapter Standard Bulk OUT Endpoint Descriptor: 9Bytes
+       + Class-specific Bulk OUT Endpoint Descriptor: 4+MIDI_CABLES Bytes */
+    /* Reference: https://www.usb.org/sites/default/files/midi10.pdf Page: 42 */
+    const uint8_t ep[] =
+    {
+      0x09, 0x05,                     // Length, Descriptor Type: Endpoint
+      MIDI_EPOUT_ADDR,                // Endpoint Address: OUT Endpoint 1 (1Byte)
+      0x02,                           // Attributes: Bulk, Not shared (1Byte)
+      LOBYTE(MIDI_EPOUT_SIZE),        // Max Packet Size: 64 Bytes (2Bytes low-byte first)
+      HIBYTE(MIDI_EPOUT_SIZE),
+      0x00, 0x00, 0x00,               // Interval, Refresh, Synch. Address: Unused
+      0x04 + MIDI_CABLES,             // Length of the Descriptor (1Byte)
+      0x25,                           // Descriptor Type: Class Specific Endpoint descriptor (1Byte)
+      0x01,                           // Descriptor Sub-type: MIDI-Streaming General sub-type (1Byte)
+      MIDI_CABLES                     // No. of Embedded MIDI IN Jacks, IDs follow (1Byte)
+    };
+    pdesc = USBD_MIDI_PutDesc(pdesc, ep, sizeof(ep));
+    for (cable = 0U; cable < MIDI_CABLES; cable++)
+    {
+      *pdesc++ = MIDI_JACK_ID(cable, 1U);
+    }
+  }
+
+  {
+    /* MIDI Adapter Standard Bulk IN Endpoint Descriptor: 9Bytes
+       + Class-specific Bulk IN Endpoint Descriptor: 4+MIDI_CABLES Bytes */
+    /* Reference: https://www.usb.org/sites/default/files/midi10.pdf Page: 42,43 */
+    const uint8_t ep[] =
+    {
+      0x09, 0x05,                     // Length, Descriptor Type: Endpoint
+      MIDI_EPIN_ADDR,                 // Endpoint Address: IN Endpoint 1 (1Byte)
+      0x02,                           // Attributes: Bulk, Not shared (1Byte)
+      LOBYTE(MIDI_EPIN_SIZE),         // Max Packet Size: 64 Bytes (2Bytes low-byte first)
+      HIBYTE(MIDI_EPIN_SIZE),
+      0x00, 0x00, 0x00,               // Interval, Refresh, Synch. Address: Unused
+      0x04 + MIDI_CABLES,             // Length of the Descriptor (1Byte)
+      0x25,                           // Descriptor Type: Class Specific Endpoint descriptor (1Byte)
+      0x01,                           // Descriptor Sub-type: MIDI-Streaming General sub-type (1Byte)
+      MIDI_CABLES                     // No. of Embedded MIDI OUT Jacks, IDs follow (1Byte)
+    };
+    pdesc = USBD_MIDI_PutDesc(pdesc, ep, sizeof(ep));
+    for (cable = 0U; cable < MIDI_CABLES; cable++)
+    {
+      *pdesc++ = MIDI_JACK_ID(cable, 3U);
+    }
+  }
+
+  {
+    /* MIDI 2.0 Standard MS Interface Descriptor, Alternate Setting 1: 9Bytes
+       + Class-specific MS Interface Header Descriptor: 7Bytes */
+    /* Reference: USB Device Class Definition for MIDI Devices 2.0, 5.2 */
+    const uint8_t itf[] =
+    {
+      0x09, 0x04,                     // Length, Descriptor Type: Interface
+      MIDI_MS_INTERFACE,              // Index of this interface (1Byte)
+      MIDI_ALT_MIDI_2_0,              // Alternate Setting: Index of this Setting (1Byte)
+      0x02,                           // Number of End-points (1Byte)
+      0x01, 0x03, 0x00,               // Class: Audio, Sub-Class: MIDI-Streaming, Protocol: Unused
+      0x00,                           // iInterface: Unused (1Byte)
+      0x07, 0x24, 0x01,               // Length, Class specific interface, Header
+      0x00, 0x02,                     // Class Specification Revision No.: 2.00 (2Bytes Low-byte first)
+      0x07, 0x00                      // Total length of class specific descriptor: header only, 7bytes
+    };
+    pdesc = USBD_MIDI_PutDesc(pdesc, itf, sizeof(itf));
+  }
+
+  {
+    /* MIDI 2.0 Standard Bulk OUT and IN Endpoint Descriptors: 7Bytes
+       + Class-specific Endpoint Descriptors: 4+MIDI_CABLES Bytes */
+    /* Reference: USB Device Class Definition for MIDI Devices 2.0, 5.3 */
+    const uint8_t addr[2] = {MIDI_EPOUT_ADDR, MIDI_EPIN_ADDR};
+    uint8_t i;
+
+    for (i = 0U; i < 2U; i++)
+    {
+      const uint8_t ep[] =
+      {
+        0x07, 0x05,                   // Length, Descriptor Type: Endpoint
+        addr[i],                      // Endpoint Address (1Byte)
+        0x02,                         // Attributes: Bulk, Not shared (1Byte)
+        LOBYTE(MIDI_DATA_FS_MAX_PACKET_SIZE), // Max Packet Size: 64 Bytes (2Bytes low-byte first)
+        HIBYTE(MIDI_DATA_FS_MAX_PACKET_SIZE),
+        0x00,                         // Interval: Ignored for bulk mode (1Byte)
+        0x04 + MIDI_CABLES,           // Length of the Descriptor (1Byte)
+        0x25,                         // Descriptor Type: Class Specific Endpoint descriptor (1Byte)
+        0x02,                         // Descriptor Sub-type: MS_GENERAL_2_0 (1Byte)
+        MIDI_CABLES                   // No. of Group Terminal Blocks, IDs follow (1Byte)
+      };
+      pdesc = USBD_MIDI_PutDesc(pdesc, ep, sizeof(ep));
+      for (cable = 0U; cable < MIDI_CABLES; cable++)
+      {
+        *pdesc++ = cable + 1U;
+      }
+    }
+  }
+
+  pdesc = USBD_MIDI_GrpTrmBlkDesc;
+  {
+    /* Group Terminal Block Header Descriptor: 5Bytes */
+    /* Reference: USB Device Class Definition for MIDI Devices 2.0, 5.4.1 */
+    const uint8_t hdr[] =
+    {
+      0x05,                           // Length of the Descriptor (1Byte)
+      MIDI_CS_GR_TRM_BLOCK,           // Descriptor Type: CS_GR_TRM_BLOCK (1Byte)
+      0x01,                           // Descriptor Sub-type: GR_TRM_BLOCK_HEADER (1Byte)
+      LOBYTE(USB_MIDI_GR_TRM_BLOCK_DESC_SIZ), // Total Length of the Group Terminal Block descriptors (2Bytes Low-byte first)
+      HIBYTE(USB_MIDI_GR_TRM_BLOCK_DESC_SIZ)
+    };
+    pdesc = USBD_MIDI_PutDesc(pdesc, hdr, sizeof(hdr));
+  }
+
+  for (cable = 0U; cable < MIDI_CABLES; cable++)
+  {
+    /* Group Terminal Block Descriptor: 13Bytes */
+    /* Reference: USB Device Class Definition for MIDI Devices 2.0, 5.4.2 */
+    const uint8_t blk[] =
+    {
+      0x0D,                           // Length of the Descriptor (1Byte)
+      MIDI_CS_GR_TRM_BLOCK,           // Descriptor Type: CS_GR_TRM_BLOCK (1Byte)
+      0x02,                           // Descriptor Sub-type: GR_TRM_BLOCK (1Byte)
+      cable + 1U,                     // Group Terminal Block ID (1Byte)
+      0x00,                           // Group Terminal Block Type: bidirectional (1Byte)
+      cable,                          // First Group: group of this cable (1Byte)
+      0x01,                           // Number of Groups spanned: 1 (1Byte)
+      0x00,                           // iBlockItem: Unused (1Byte)
+      MIDI_BLOCK_PROTOCOL,            // MIDI Protocol: MIDI 2.0, with JR Timestamps if enabled (1Byte)
+      0x00, 0x00,                     // Max Input Bandwidth: unknown (2Bytes Low-byte first)
+      0x00, 0x00                      // Max Output Bandwidth: unknown (2Bytes Low-byte first)
+    };
+    pdesc = USBD_MIDI_PutDesc(pdesc, blk, sizeof(blk));
+  }
+
+  USBD_MIDI_DescReady = 1U;
+}
+
+/**
+  * @brief  USBD_MIDI_Init
+  *         Initialize the MIDI interface and open both bulk endpoints
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_MIDI_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  UNUSED(cfgidx);
+
+  USBD_MIDI_HandleTypeDef *hmidi;
+
+  hmidi = (USBD_MIDI_HandleTypeDef *)USBD_malloc(sizeof(USBD_MIDI_HandleTypeDef));
+
+  if (hmidi == NULL)
+  {
+    pdev->pClassDataCmsit[pdev->classId] = NULL;
+    return (uint8_t)USBD_EMEM;
+  }
+
+  (void)USBD_memset(hmidi, 0, sizeof(USBD_MIDI_HandleTypeDef));
+
+  pdev->pClassDataCmsit[pdev->classId] = (void *)hmidi;
+  pdev->pClassData = pdev->pClassDataCmsit[pdev->classId];
+
+  /* Open EP IN */
+  (void)USBD_LL_OpenEP(pdev, MIDIInEpAdd, USBD_EP_TYPE_BULK, MIDI_EPIN_SIZE);
+  pdev->ep_in[MIDIInEpAdd & 0xFU].is_used = 1U;
+
+  /* Open EP OUT */
+  (void)USBD_LL_OpenEP(pdev, MIDIOutEpAdd, USBD_EP_TYPE_BULK, MIDI_EPOUT_SIZE);
+  pdev->ep_out[MIDIOutEpAdd & 0xFU].is_used = 1U;
+
+  hmidi->TxState = MIDI_IDLE;
+
+  if (pdev->pUserData[pdev->classId] != NULL)
+  {
+    ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[pdev->classId])->Init();
+  }
+
+  /* Prepare Out endpoint to receive next packet */
+  (void)USBD_LL_PrepareReceive(pdev, MIDIOutEpAdd, (uint8_t *)hmidi->RxBuffer, MIDI_EPOUT_SIZE);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_DeInit
+  *         DeInitialize the MIDI layer
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_MIDI_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  UNUSED(cfgidx);
+
+  /* Close MIDI EPs */
+  (void)USBD_LL_CloseEP(pdev, MIDIInEpAdd);
+  pdev->ep_in[MIDIInEpAdd & 0xFU].is_used = 0U;
+
+  (void)USBD_LL_CloseEP(pdev, MIDIOutEpAdd);
+  pdev->ep_out[MIDIOutEpAdd & 0xFU].is_used = 0U;
+
+  /* Free allocated memory */
+  if (pdev->pClassDataCmsit[pdev->classId] != NULL)
+  {
+    if (pdev->pUserData[pdev->classId] != NULL)
+    {
+      ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[pdev->classId])->DeInit();
+    }
+    (void)USBD_free(pdev->pClassDataCmsit[pdev->classId]);
+    pdev->pClassDataCmsit[pdev->classId] = NULL;
+    pdev->pClassData = NULL;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_Setup
+  *         Handle the MIDI specific requests
+  * @param  pdev: instance
+  * @param  req: usb requests
+  * @retval status
+  */
+static uint8_t USBD_MIDI_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_MIDI_HandleTypeDef *hmidi = (USBD_MIDI_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_StatusTypeDef ret = USBD_OK;
+  /* EP0 data stage reads these after Setup returns: keep them off the stack */
+  static uint16_t status_info;
+  static uint8_t ifalt;
+  uint16_t len;
+
+  if (hmidi == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  status_info = 0U;
+  ifalt = 0U;
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+    case USB_REQ_TYPE_STANDARD:
+      switch (req->bRequest)
+      {
+        case USB_REQ_GET_STATUS:
+          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          {
+            (void)USBD_CtlSendData(pdev, (uint8_t *)&status_info, 2U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_GET_DESCRIPTOR:
+          if (((req->wValue >> 8) == MIDI_CS_GR_TRM_BLOCK) &&
+              (LOBYTE(req->wIndex) == MIDI_MS_INTERFACE))
+          {
+            USBD_MIDI_BuildDesc();
+            len = MIN(USB_MIDI_GR_TRM_BLOCK_DESC_SIZ, req->wLength);
+            (void)USBD_CtlSendData(pdev, USBD_MIDI_GrpTrmBlkDesc, len);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_GET_INTERFACE:
+          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          {
+            if (LOBYTE(req->wIndex) == MIDI_MS_INTERFACE)
+            {
+              ifalt = (uint8_t)hmidi->AltSetting;
+            }
+            (void)USBD_CtlSendData(pdev, &ifalt, 1U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_SET_INTERFACE:
+          if ((pdev->dev_state == USBD_STATE_CONFIGURED) &&
+              (LOBYTE(req->wIndex) == MIDI_MS_INTERFACE) &&
+              ((uint8_t)(req->wValue) <= MIDI_ALT_MIDI_2_0))
+          {
+            USBD_MIDI_SetAlt(pdev, (uint8_t)(req->wValue));
+          }
+          else if ((pdev->dev_state == USBD_STATE_CONFIGURED) &&
+                   (LOBYTE(req->wIndex) != MIDI_MS_INTERFACE) && (req->wValue == 0U))
+          {
+            /* Audio Control interface has a single alternate setting */
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_CLEAR_FEATURE:
+          break;
+
+        default:
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+          break;
+      }
+      break;
+
+    default:
+      USBD_CtlError(pdev, req);
+      ret = USBD_FAIL;
+      break;
+  }
+
+  return (uint8_t)ret;
+}
+
+/**
+  * @brief  USBD_MIDI_SetAlt
+  *         Switch the MIDI Streaming interface between MIDI 1.0 event
+  *         packets and Universal MIDI Packets. Both endpoints are reopened,
+  *         which resets the data toggles and drops any transfer in flight.
+  * @param  pdev: device instance
+  * @param  alt: new alternate setting
+  * @retval None
+  */
+static void USBD_MIDI_SetAlt(USBD_HandleTypeDef *pdev, uint8_t alt)
+{
+  USBD_MIDI_HandleTypeDef *hmidi = (USBD_MIDI_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  (void)USBD_LL_CloseEP(pdev, MIDIInEpAdd);
+  (void)USBD_LL_CloseEP(pdev, MIDIOutEpAdd);
+  (void)USBD_LL_OpenEP(pdev, MIDIInEpAdd, USBD_EP_TYPE_BULK, MIDI_EPIN_SIZE);
+  (void)USBD_LL_OpenEP(pdev, MIDIOutEpAdd, USBD_EP_TYPE_BULK, MIDI_EPOUT_SIZE);
+
+  hmidi->AltSetting = alt;
+  hmidi->TxState = MIDI_IDLE;
+
+  if (pdev->pUserData[pdev->classId] != NULL)
+  {
+    ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[pdev->classId])->SetAlt(alt);
+  }
+
+  (void)USBD_LL_PrepareReceive(pdev, MIDIOutEpAdd, (uint8_t *)hmidi->RxBuffer, MIDI_EPOUT_SIZE);
+}
+
+/**
+  * @brief  USBD_MIDI_RegisterInterface
+  * @param  pdev: device instance
+  * @param  fops: MIDI interface callback
+  * @retval status
+  */
+uint8_t USBD_MIDI_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_MIDI_ItfTypeDef *fops)
+{
+  if (fops == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  pdev->pUserData[pdev->classId] = fops;
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_Transmit
+  *         Start a bulk IN transfer of up to MIDI_EPIN_SIZE bytes
+  *         (MIDI_EVENTS_PER_TRANSFER event packets). The buffer must stay
+  *         valid until the TransmitCplt callback.
+  * @param  pdev: device instance
+  * @param  pbuff: pointer to the event packets
+  * @param  length: number of bytes, multiple of MIDI_EVENT_PACKET_SIZE
+  * @retval status
+  */
+uint8_t USBD_MIDI_Transmit(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uint32_t length)
+{
+  USBD_MIDI_HandleTypeDef *hmidi = (USBD_MIDI_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if (hmidi == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if ((pdev->dev_state != USBD_STATE_CONFIGURED) || (length > MIDI_EPIN_SIZE))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if (hmidi->TxState != MIDI_IDLE)
+  {
+    return (uint8_t)USBD_BUSY;
+  }
+
+  hmidi->TxState = MIDI_BUSY;
+  hmidi->TxBuffer = pbuff;
+  hmidi->TxLength = length;
+
+  /* Update the packet total length */
+  pdev->ep_in[MIDIInEpAdd & 0xFU].total_length = length;
+
+  (void)USBD_LL_Transmit(pdev, MIDIInEpAdd, pbuff, length);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_ReceivePacket
+  *         Prepare OUT Endpoint for reception
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_MIDI_ReceivePacket(USBD_HandleTypeDef *pdev)
+{
+  USBD_MIDI_HandleTypeDef *hmidi = (USBD_MIDI_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if (hmidi == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  (void)USBD_LL_PrepareReceive(pdev, MIDIOutEpAdd, (uint8_t *)hmidi->RxBuffer, MIDI_EPOUT_SIZE);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_DataIn
+  *         Data sent on non-control IN endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_MIDI_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_MIDI_HandleTypeDef *hmidi = (USBD_MIDI_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if (hmidi == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hmidi->TxState = MIDI_IDLE;
+
+  if (pdev->pUserData[pdev->classId] != NULL)
+  {
+    ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[pdev->classId])->TransmitCplt(hmidi->TxBuffer, hmidi->TxLength);
+  }
+
+  UNUSED(epnum);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_DataOut
+  *         Data received on non-control Out endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_MIDI_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_MIDI_HandleTypeDef *hmidi = (USBD_MIDI_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if (hmidi == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  /* Get the received data length */
+  hmidi->RxLength = USBD_LL_GetRxDataSize(pdev, epnum);
+
+  /* The interface consumes the buffer in place and re-arms the endpoint
+     with USBD_MIDI_ReceivePacket() once done */
+  if (pdev->pUserData[pdev->classId] != NULL)
+  {
+    ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[pdev->classId])->Receive((uint8_t *)hmidi->RxBuffer, hmidi->RxLength);
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_SOF
+  *         Start Of Frame event, once per 1 ms full-speed frame
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t USBD_MIDI_SOF(USBD_HandleTypeDef *pdev)
+{
+  if ((pdev->pClassDataCmsit[pdev->classId] != NULL) && (pdev->pUserData[pdev->classId] != NULL))
+  {
+    ((USBD_MIDI_ItfTypeDef *)pdev->pUserData[pdev->classId])->SOF();
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_MIDI_GetFSCfgDesc
+  *         return FS configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_MIDI_GetFSCfgDesc(uint16_t *length)
+{
+  USBD_MIDI_BuildDesc();
+  *length = (uint16_t)sizeof(USBD_MIDI_CfgDesc);
+  return USBD_MIDI_CfgDesc;
+}
+
+/**
+  * @brief  USBD_MIDI_GetHSCfgDesc
+  *         return HS configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_MIDI_GetHSCfgDesc(uint16_t *length)
+{
+  USBD_MIDI_BuildDesc();
+  *length = (uint16_t)sizeof(USBD_MIDI_CfgDesc);
+  return USBD_MIDI_CfgDesc;
+}
+
+/**
+  * @brief  USBD_MIDI_GetOtherSpeedCfgDesc
+  *         return other speed configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_MIDI_GetOtherSpeedCfgDesc(uint16_t *length)
+{
+  USBD_MIDI_BuildDesc();
+  *length = (uint16_t)sizeof(USBD_MIDI_CfgDesc);
+  return USBD_MIDI_CfgDesc;
+}
+
+/**
+  * @brief  DeviceQualifierDescriptor
+  *         return Device Qualifier descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_MIDI_GetDeviceQualifierDesc(uint16_t *length)
+{
+  *length = (uint16_t)sizeof(USBD_MIDI_DeviceQualifierDesc);
+
+  return USBD_MIDI_DeviceQualifierDesc;
+}
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
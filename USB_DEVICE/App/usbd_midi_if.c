@@ -0,0 +1,453 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : usbd_midi_if.c
+  * @version        : v1.0_Cube
+  * @brief          : Usb device for MIDI.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2023 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_midi_if.h"
+
+/* USER CODE BEGIN INCLUDE */
+#include "midi_queue.h"
+#include "midi_message.h"
+/* USER CODE END INCLUDE */
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef struct
+{
+  MIDI_QueueId Queue;
+  uint8_t Weight;      /* Words guaranteed to the queue in every transfer */
+} MIDI_TxSlotTypeDef;
+
+/* One queue per cable, the descriptor must declare exactly as many */
+typedef char MIDI_CablesCheck[(MIDI_CABLES == MIDI_QUEUE_COUNT) ? 1 : -1];
+
+/* Schedule slot of the outgoing SysEx stream, next to the queue slots */
+#define MIDI_TX_SYSEX ((MIDI_QueueId)MIDI_QUEUE_COUNT)
+#define MIDI_TX_SLOTS (MIDI_QUEUE_COUNT + 1U)
+
+/* USER CODE END PTD */
+
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+
+/* USER CODE BEGIN PV */
+/* Private variables ---------------------------------------------------------*/
+/* Ping-pong IN buffers: MIDI_TxFill is being packed from the queues while
+   the other one may be owned by the endpoint until TransmitCplt */
+__ALIGN_BEGIN static uint32_t MIDI_TxBuffer[2][MIDI_EVENTS_PER_TRANSFER] __ALIGN_END;
+static uint32_t MIDI_TxCount[2];
+static uint8_t MIDI_TxFill;
+/* Host frame counter, 11-bit SOF frame number extended to 32 bits */
+static volatile uint32_t MIDI_FrameCount;
+static uint32_t MIDI_LastFrameNumber;
+/* DWT->CYCCNT at the SOF of MIDI_FrameCount, finer time inside the frame */
+static volatile uint32_t MIDI_FrameCycle;
+/* Weighted schedule of the IN transfer, in service order. Weights add up to
+   MIDI_EVENTS_PER_TRANSFER so every cable keeps its share of each 64-byte
+   transfer, and a flood on one cable cannot starve the performance cable.
+   An outgoing SysEx has its own share and takes the idle words on top, it
+   never holds back the other cables */
+static const MIDI_TxSlotTypeDef MIDI_TxSchedule[MIDI_TX_SLOTS] =
+{
+  {MIDI_QUEUE_REALTIME, 2U},
+  {MIDI_QUEUE_KEYS,     8U},
+  {MIDI_TX_SYSEX,       2U},
+  {MIDI_QUEUE_ENCODERS, 2U},
+  {MIDI_QUEUE_ANALOG,   2U},
+};
+
+/* USER CODE END PV */
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief Usb device library.
+  * @{
+  */
+
+/** @addtogroup USBD_MIDI_IF
+  * @{
+  */
+
+/** @defgroup USBD_MIDI_IF_Exported_Variables USBD_MIDI_IF_Exported_Variables
+  * @brief Public variables.
+  * @{
+  */
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+/* USER CODE BEGIN EXPORTED_VARIABLES */
+
+/* USER CODE END EXPORTED_VARIABLES */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_MIDI_IF_Private_FunctionPrototypes USBD_MIDI_IF_Private_FunctionPrototypes
+  * @brief Private functions declaration.
+  * @{
+  */
+
+static int8_t MIDI_Init_FS(void);
+static int8_t MIDI_DeInit_FS(void);
+static int8_t MIDI_Receive_FS(uint8_t* pbuf, uint32_t Len);
+static int8_t MIDI_TransmitCplt_FS(uint8_t *pbuf, uint32_t Len);
+static int8_t MIDI_SOF_FS(void);
+static int8_t MIDI_SetAlt_FS(uint8_t AltSetting);
+
+/* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static void MIDI_TxPack_FS(void);
+static void MIDI_TxSwap_FS(void);
+static uint32_t MIDI_TxTake_FS(MIDI_QueueId id, uint32_t *buf, uint32_t count, uint32_t limit);
+
+/* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
+
+/**
+  * @}
+  */
+
+USBD_MIDI_ItfTypeDef USBD_MIDI_Interface_fops_FS =
+{
+  MIDI_Init_FS,
+  MIDI_DeInit_FS,
+  MIDI_Receive_FS,
+  MIDI_TransmitCplt_FS,
+  MIDI_SOF_FS,
+  MIDI_SetAlt_FS
+};
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Initializes the MIDI media low layer over the FS USB IP
+  * @retval USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t MIDI_Init_FS(void)
+{
+  /* USER CODE BEGIN 3 */
+  /* The frame timebase restarts with every configuration */
+  MIDI_LastFrameNumber = USBD_LL_GetFrameNumber(&hUsbDeviceFS);
+  MIDI_FrameCount = 0U;
+  MIDI_TxCount[0] = 0U;
+  MIDI_TxCount[1] = 0U;
+  /* A new configuration always starts on alternate setting 0 */
+  MIDI_SetProtocol(MIDI_PROTOCOL_1_0);
+  return (USBD_OK);
+  /* USER CODE END 3 */
+}
+
+/**
+  * @brief  DeInitializes the MIDI media low layer
+  * @retval USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t MIDI_DeInit_FS(void)
+{
+  /* USER CODE BEGIN 4 */
+  return (USBD_OK);
+  /* USER CODE END 4 */
+}
+
+/**
+  * @brief  Data received over USB OUT endpoint are sent over MIDI interface
+  *         through this function.
+  *
+  *         @note
+  *         This function will issue a NAK packet on any OUT packet received on
+  *         USB endpoint until exiting this function. If you exit this function
+  *         before transfer is complete on MIDI interface (ie. using DMA controller)
+  *         it will result in receiving more data while previous ones are still
+  *         not sent.
+  *
+  * @param  Buf: Buffer of data to be received
+  * @param  Len: Number of data received (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t MIDI_Receive_FS(uint8_t* Buf, uint32_t Len)
+{
+  /* USER CODE BEGIN 6 */
+  /* Parse in place, then hand the buffer back to the endpoint */
+  if (MIDI_GetProtocol() == MIDI_PROTOCOL_2_0)
+  {
+    MIDI_ParseUMP((uint32_t *)Buf, Len / 4U);
+  }
+  else
+  {
+    MIDI_ParsePackets(Buf, Len);
+  }
+  USBD_MIDI_ReceivePacket(&hUsbDeviceFS);
+  return (USBD_OK);
+  /* USER CODE END 6 */
+}
+
+/**
+  * @brief  MIDI_Transmit_FS
+  *         Data to send over USB IN endpoint are sent over MIDI interface
+  *         through this function. Up to MIDI_EVENTS_PER_TRANSFER event
+  *         packets can be sent in a single call.
+  *
+  * @param  Buf: Buffer of data to be sent
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval USBD_OK if all operations are OK else USBD_FAIL or USBD_BUSY
+  */
+uint8_t MIDI_Transmit_FS(uint8_t* Buf, uint16_t Len)
+{
+  uint8_t result = USBD_OK;
+  /* USER CODE BEGIN 7 */
+  result = USBD_MIDI_Transmit(&hUsbDeviceFS, Buf, Len);
+  /* USER CODE END 7 */
+  return result;
+}
+
+/**
+  * @brief  MIDI_TransmitCplt_FS
+  *         Data transmitted callback
+  *
+  * @param  Buf: Buffer of data that has been sent
+  * @param  Len: Number of data sent (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t MIDI_TransmitCplt_FS(uint8_t *Buf, uint32_t Len)
+{
+  uint8_t result = USBD_OK;
+  /* USER CODE BEGIN 13 */
+  UNUSED(Buf);
+  UNUSED(Len);
+  /* A batch packed while the endpoint was busy leaves right away */
+  MIDI_TxSwap_FS();
+  /* USER CODE END 13 */
+  return result;
+}
+
+/**
+  * @brief  MIDI_SOF_FS
+  *         Start Of Frame callback: advance the frame timebase and flush
+  *         the event queues, exactly once per host frame.
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t MIDI_SOF_FS(void)
+{
+  /* USER CODE BEGIN 14 */
+  uint32_t frame = USBD_LL_GetFrameNumber(&hUsbDeviceFS);
+
+  /* Account for SOFs missed while the interrupt was masked */
+  MIDI_FrameCycle = DWT->CYCCNT;
+  MIDI_FrameCount += (frame - MIDI_LastFrameNumber) & 0x7FFU;
+  MIDI_LastFrameNumber = frame;
+
+  MIDI_TxPack_FS();
+  if (((USBD_MIDI_HandleTypeDef *)hUsbDeviceFS.pClassData)->TxState == MIDI_IDLE)
+  {
+    MIDI_TxSwap_FS();
+  }
+  return (USBD_OK);
+  /* USER CODE END 14 */
+}
+
+/**
+  * @brief  MIDI_SetAlt_FS
+  *         MIDI Streaming alternate setting selected by the host: 0 for
+  *         USB-MIDI 1.0 event packets, 1 for Universal MIDI Packets.
+  *         Called from the USB interrupt, like SOF, so the rings and the
+  *         IN buffers can be reset here without racing the consumer.
+  *         A producer preempted between encoding and pushing can still
+  *         add an old-format message after the flush; MIDI_SetProtocol
+  *         bumps the epoch, and MIDI_TxTake_FS drops words tagged with
+  *         an older one.
+  * @param  AltSetting: new alternate setting
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t MIDI_SetAlt_FS(uint8_t AltSetting)
+{
+  /* USER CODE BEGIN 15 */
+  MIDI_SetProtocol((AltSetting == MIDI_ALT_MIDI_2_0) ? MIDI_PROTOCOL_2_0 : MIDI_PROTOCOL_1_0);
+
+  /* Anything queued or packed so far is in the format of the old setting */
+  for (uint32_t id = 0U; id < MIDI_QUEUE_COUNT; id++)
+  {
+    MIDI_Queue_Flush((MIDI_QueueId)id);
+  }
+  MIDI_SysEx_Abort();
+  MIDI_TxCount[0] = 0U;
+  MIDI_TxCount[1] = 0U;
+  MIDI_TxFill = 0U;
+  MIDI_LastFrameNumber = USBD_LL_GetFrameNumber(&hUsbDeviceFS);
+  MIDI_FrameCount = 0U;
+  return (USBD_OK);
+  /* USER CODE END 15 */
+}
+
+/* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+/**
+  * @brief  MIDI_GetFrame_FS
+  *         USB frame timebase, incremented on every 1 ms host frame.
+  * @retval Number of frames since the device was configured or the
+  *         alternate setting last changed
+  */
+uint32_t MIDI_GetFrame_FS(void)
+{
+  return MIDI_FrameCount;
+}
+
+/**
+  * @brief  MIDI_GetFrameTime_FS
+  *         Frame timebase together with the core cycles elapsed since the
+  *         SOF of that frame. The SOF interrupt preempts every caller, so
+  *         a changed frame number means the pair has to be read again.
+  * @param  cycles: receives DWT->CYCCNT cycles since the SOF
+  * @retval Frame number, as MIDI_GetFrame_FS
+  */
+uint32_t MIDI_GetFrameTime_FS(uint32_t *cycles)
+{
+  uint32_t frame;
+
+  do
+  {
+    frame = MIDI_FrameCount;
+    *cycles = DWT->CYCCNT - MIDI_FrameCycle;
+  } while (frame != MIDI_FrameCount);
+
+  return frame;
+}
+
+/**
+  * @brief  MIDI_TxPack_FS
+  *         Top up the fill buffer with pending event packets, up to
+  *         MIDI_EVENTS_PER_TRANSFER 32-bit words. Every queue and the
+  *         outgoing SysEx take up to their weight from MIDI_TxSchedule,
+  *         and the words left over go to whichever still have data, in
+  *         schedule order.
+  *         A multi-word UMP or a MIDI_GROUP of packets is never split
+  *         between two transfers.
+  *         Only called from the SOF callback, which makes it the single
+  *         consumer of the rings.
+  * @retval None
+  */
+static void MIDI_TxPack_FS(void)
+{
+  uint32_t *buf = MIDI_TxBuffer[MIDI_TxFill];
+  uint32_t count = MIDI_TxCount[MIDI_TxFill];
+
+  for (uint32_t i = 0U; i < MIDI_TX_SLOTS; i++)
+  {
+    count = MIDI_TxTake_FS(MIDI_TxSchedule[i].Queue, buf, count, count + MIDI_TxSchedule[i].Weight);
+  }
+  for (uint32_t i = 0U; i < MIDI_TX_SLOTS; i++)
+  {
+    count = MIDI_TxTake_FS(MIDI_TxSchedule[i].Queue, buf, count, MIDI_EVENTS_PER_TRANSFER);
+  }
+
+  MIDI_TxCount[MIDI_TxFill] = count;
+}
+
+/**
+  * @brief  MIDI_TxTake_FS
+  *         Move whole messages from one queue to the fill buffer while the
+  *         buffer holds fewer than limit words. The last message may run
+  *         past limit, never past the end of the buffer.
+  * @param  id: queue to take from, or MIDI_TX_SYSEX for the outgoing SysEx
+  * @param  buf: fill buffer
+  * @param  count: words already in the buffer
+  * @param  limit: stop once this many words are in the buffer
+  * @retval New number of words in the buffer
+  */
+static uint32_t MIDI_TxTake_FS(MIDI_QueueId id, uint32_t *buf, uint32_t count, uint32_t limit)
+{
+  uint32_t word;
+  uint8_t tag;
+  uint8_t epoch = MIDI_GetEpoch();
+
+  if (limit > MIDI_EVENTS_PER_TRANSFER)
+  {
+    limit = MIDI_EVENTS_PER_TRANSFER;
+  }
+  if (id == MIDI_TX_SYSEX)
+  {
+    return (count < limit) ? count + MIDI_SysEx_Encode(&buf[count], limit - count) : count;
+  }
+  /* A SysEx in progress owns its cable only: channel messages queued on
+     that cable meanwhile wait until its F7 has been packed, so they are
+     never interleaved with it. The other cables keep flowing */
+  if (MIDI_SysEx_TxOwns((uint8_t)id))
+  {
+    return count;
+  }
+
+  while ((count < limit) && MIDI_Queue_Peek(id, &word, &tag))
+  {
+    uint32_t n;
+    uint32_t marker;
+
+    if (tag != epoch)
+    {
+      /* Encoded before the last SET_INTERFACE and pushed after its flush:
+         the old format cannot be sized or sent, so drop it word by word */
+      (void)MIDI_Queue_Pop(id, &word);
+      continue;
+    }
+    n = MIDI_WordCount(word);
+    marker = MIDI_IS_GROUP(word) ? 1U : 0U;
+    if (count + n - marker > MIDI_EVENTS_PER_TRANSFER)
+    {
+      break;
+    }
+    if (marker != 0U)
+    {
+      /* The group marker only keeps the packets together, it is not sent */
+      (void)MIDI_Queue_Pop(id, &word);
+      n--;
+    }
+    while ((n-- > 0U) && MIDI_Queue_Pop(id, &buf[count]))
+    {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+/**
+  * @brief  MIDI_TxSwap_FS
+  *         Hand the fill buffer to the idle IN endpoint and start filling
+  *         the buffer that has just been released.
+  * @retval None
+  */
+static void MIDI_TxSwap_FS(void)
+{
+  uint8_t fill = MIDI_TxFill;
+
+  if ((MIDI_TxCount[fill] == 0U) || (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED))
+  {
+    return;
+  }
+
+  if (MIDI_Transmit_FS((uint8_t *)MIDI_TxBuffer[fill],
+                       (uint16_t)(MIDI_TxCount[fill] * MIDI_EVENT_PACKET_SIZE)) == USBD_OK)
+  {
+    MIDI_TxFill = fill ^ 1U;
+    MIDI_TxCount[MIDI_TxFill] = 0U;
+  }
+}
+
+/* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
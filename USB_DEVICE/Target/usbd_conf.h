@@ -63,7 +63,7 @@
   */
 
 /*---------- -----------*/
-#define USBD_MAX_NUM_INTERFACES     1U
+#define USBD_MAX_NUM_INTERFACES     2U
 /*---------- -----------*/
 #define USBD_MAX_NUM_CONFIGURATION     1U
 /*---------- -----------*/
@@ -76,6 +76,8 @@
 #define USBD_SELF_POWERED     1U
 /*---------- -----------*/
 #define HID_FS_BINTERVAL     0xAU
+/*---------- -----------*/
+#define MIDI_CABLES     4U
 
 /****************************************/
 /* #define for FS and HS identification */
@@ -154,6 +156,8 @@
 /* Exported functions -------------------------------------------------------*/
 void *USBD_static_malloc(uint32_t size);
 void USBD_static_free(void *p);
+struct _USBD_HandleTypeDef;
+uint32_t USBD_LL_GetFrameNumber(struct _USBD_HandleTypeDef *pdev);
 
 /**
   * @}